@@ -0,0 +1,66 @@
+#ifndef ALIGNED_H
+#define ALIGNED_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+// Cache line size used for all aligned buffers
+constexpr std::size_t CACHE_LINE = 64;
+
+// Number of doubles in one cache line
+constexpr std::size_t DOUBLES_PER_LINE = CACHE_LINE / sizeof(double);
+
+// Round n up to a whole number of cache lines worth of doubles
+constexpr std::size_t padToLine(std::size_t n) {
+  return (n + DOUBLES_PER_LINE - 1) / DOUBLES_PER_LINE * DOUBLES_PER_LINE;
+}
+
+// Round n up to a whole number of cache lines worth of T
+template <typename T> constexpr std::size_t padToLineOf(std::size_t n) {
+  return (n + CACHE_LINE / sizeof(T) - 1) / (CACHE_LINE / sizeof(T)) *
+         (CACHE_LINE / sizeof(T));
+}
+
+// Allocator returning memory aligned to Alignment bytes
+template <typename T, std::size_t Alignment = CACHE_LINE>
+struct AlignedAllocator {
+  using value_type = T;
+
+  template <typename U> struct rebind {
+    using other = AlignedAllocator<U, Alignment>;
+  };
+
+  AlignedAllocator() noexcept = default;
+  template <typename U>
+  AlignedAllocator(const AlignedAllocator<U, Alignment> &) noexcept {}
+
+  T *allocate(std::size_t n) {
+    return static_cast<T *>(
+        ::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+  }
+
+  void deallocate(T *p, std::size_t) noexcept {
+    ::operator delete(p, std::align_val_t(Alignment));
+  }
+
+  template <typename U>
+  bool operator==(const AlignedAllocator<U, Alignment> &) const noexcept {
+    return true;
+  }
+  template <typename U>
+  bool operator!=(const AlignedAllocator<U, Alignment> &) const noexcept {
+    return false;
+  }
+};
+
+// Cache line aligned vector of doubles
+using AlignedVector = std::vector<double, AlignedAllocator<double>>;
+
+// Cache line aligned buffers for the reduced precision inference engines
+using AlignedFloatVector = std::vector<float, AlignedAllocator<float>>;
+using AlignedInt8Vector = std::vector<int8_t, AlignedAllocator<int8_t>>;
+using AlignedUint8Vector = std::vector<uint8_t, AlignedAllocator<uint8_t>>;
+
+#endif // ALIGNED_H
@@ -0,0 +1,373 @@
+// Throughput benchmarks for the simulation, inference and training paths.
+//
+//   bench [--filter TEXT] [--min-time SECONDS] [--repetitions N]
+//         [--json FILE] [--baseline FILE] [--threshold FRACTION]
+//
+// Each benchmark is timed repetitions times, every run long enough to last
+// min-time seconds, and reported as the median time per operation. --json
+// writes the results; --baseline compares against an earlier --json file and
+// exits with status 1 if any benchmark got slower by more than threshold
+// (default 0.10, i.e. 10%).
+//
+// Build from the repository root with the game sources except main.cpp:
+//   g++ -O2 -std=c++17 -I. -o snake_bench bench/bench.cpp
+//       $(ls *.cpp | grep -v main.cpp) -lncurses -pthread
+
+#include "fixed_network.h"
+#include "kernels.h"
+#include "nn.h"
+#include "rng.h"
+#include "snake.h"
+#include "training.h"
+#include "vec_env.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct BenchOptions {
+  std::string filter;
+  double minTime = 0.2;
+  int repetitions = 5;
+  std::string jsonFile;
+  std::string baselineFile;
+  double threshold = 0.10;
+};
+
+struct BenchResult {
+  std::string name;
+  double nsPerOp;    // Median over repetitions
+  double minNsPerOp; // Fastest repetition
+  long iterations;   // Operations per repetition
+};
+
+// Every network and game is seeded, so each run measures the same work
+const uint64_t BENCH_SEED = 1;
+
+// Results are folded into this so the compiler cannot drop the work
+volatile double sink;
+
+// Cheap deterministic action source, so the generator does not dominate
+struct ActionSource {
+  uint64_t state = 0x9E3779B97F4A7C15ull;
+  int next() {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return static_cast<int>(state & 3);
+  }
+};
+
+class Bench {
+public:
+  explicit Bench(const BenchOptions &options) : options(options) {}
+
+  // Time op(n), which must perform n operations. The iteration count is
+  // doubled until one run lasts minTime, then the run is repeated.
+  template <typename Op> void run(const std::string &name, Op op) {
+    if (name.find(options.filter) == std::string::npos) {
+      return;
+    }
+
+    long n = 1;
+    double seconds = 0.0;
+    while ((seconds = time(op, n)) < options.minTime) {
+      n = seconds > 0.0 ? std::max(n * 2, static_cast<long>(
+                                              n * options.minTime / seconds))
+                        : n * 2;
+    }
+
+    std::vector<double> samples;
+    for (int r = 0; r < options.repetitions; ++r) {
+      samples.push_back(time(op, n) * 1e9 / n);
+    }
+    std::sort(samples.begin(), samples.end());
+
+    BenchResult result{name, samples[samples.size() / 2], samples.front(), n};
+    std::printf("%-28s %12.1f ns/op %12.1f min %14.0f ops/s\n", name.c_str(),
+                result.nsPerOp, result.minNsPerOp, 1e9 / result.nsPerOp);
+    std::fflush(stdout);
+    results.push_back(result);
+  }
+
+  const std::vector<BenchResult> &getResults() const { return results; }
+
+private:
+  const BenchOptions &options;
+  std::vector<BenchResult> results;
+
+  template <typename Op> static double time(Op &op, long n) {
+    auto start = std::chrono::steady_clock::now();
+    op(n);
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         start)
+        .count();
+  }
+};
+
+std::string topologyName(const std::vector<int> &topology) {
+  std::string name;
+  for (int neurons : topology) {
+    name += (name.empty() ? "" : "-") + std::to_string(neurons);
+  }
+  return name;
+}
+
+void benchSimulation(Bench &bench) {
+  // Random play on the training board; finished games are reset, as in
+  // training
+  bench.run("snake_step", [](long n) {
+    SnakeGame game(20, 40, BENCH_SEED);
+    ActionSource actions;
+    for (long i = 0; i < n; ++i) {
+      if (game.isGameOver()) {
+        game.reset();
+      }
+      game.step(static_cast<SnakeGame::Direction>(actions.next()));
+    }
+    sink = game.getScore();
+  });
+
+  bench.run("game_state", [](long n) {
+    SnakeGame game(20, 40, BENCH_SEED);
+    double state[SnakeGame::STATE_SIZE];
+    double sum = 0.0;
+    for (long i = 0; i < n; ++i) {
+      game.getGameState(state);
+      sum += state[7];
+    }
+    sink = sum;
+  });
+
+  // Per game-step, 64 games at a time
+  bench.run("vec_env_step", [](long n) {
+    const size_t games = 64;
+    VecSnakeEnv env(games, 20, 40, BENCH_SEED);
+    ActionSource source;
+    std::vector<int> actions(games);
+    std::vector<double> nextStates(games * VecSnakeEnv::STATE_SIZE);
+    std::vector<double> rewards(games);
+    std::vector<uint8_t> dones(games);
+    for (long i = 0; i < n; i += games) {
+      for (int &action : actions) {
+        action = source.next();
+      }
+      env.step(actions.data(), nextStates.data(), rewards.data(),
+               dones.data());
+    }
+    sink = rewards[0];
+  });
+}
+
+void benchNetwork(Bench &bench, const std::vector<int> &topology) {
+  std::string suffix = "/" + topologyName(topology);
+  std::vector<double> input(topology.front(), 0.5);
+  std::vector<double> target(topology.back(), 0.25);
+
+  bench.run("feed_forward" + suffix, [&](long n) {
+    NeuralNetwork nn(topology, BENCH_SEED);
+    double sum = 0.0;
+    for (long i = 0; i < n; ++i) {
+      input[0] = i & 1;
+      sum += nn.feedForward(input.data())[0];
+    }
+    sink = sum;
+  });
+
+  bench.run("get_action" + suffix, [&](long n) {
+    NeuralNetwork nn(topology, BENCH_SEED);
+    long sum = 0;
+    for (long i = 0; i < n; ++i) {
+      input[0] = i & 1;
+      sum += nn.getAction(input.data());
+    }
+    sink = sum;
+  });
+
+  // One forward pass plus the weight update, as in training
+  bench.run("back_propagate" + suffix, [&](long n) {
+    NeuralNetwork nn(topology, BENCH_SEED);
+    for (long i = 0; i < n; ++i) {
+      nn.feedForward(input.data());
+      nn.backPropagate(target.data(), LEARNING_RATE);
+    }
+    sink = nn.getWeights(0)[0];
+  });
+}
+
+void benchFixedNetwork(Bench &bench) {
+  std::vector<double> input(SnakeNetwork::INPUTS, 0.5);
+  bench.run("fixed_get_action/" + topologyName(NETWORK_TOPOLOGY),
+            [&](long n) {
+              SnakeNetwork fixed{NeuralNetwork(NETWORK_TOPOLOGY, BENCH_SEED)};
+              long sum = 0;
+              for (long i = 0; i < n; ++i) {
+                input[0] = i & 1;
+                sum += fixed.getAction(input.data());
+              }
+              sink = sum;
+            });
+}
+
+// End-to-end online Q-learning as in trainAI(), without output: epsilon
+// greedy action, game step, reward, state and Q-value update per step
+void benchTraining(Bench &bench) {
+  bench.run("train_step", [](long n) {
+    NeuralNetwork nn(NETWORK_TOPOLOGY, BENCH_SEED);
+    nn.enableTargetNetwork(TARGET_SYNC_INTERVAL);
+    SnakeGame game(20, 40, BENCH_SEED);
+    Rng rng(BENCH_SEED, Stream::EXPLORATION);
+    double state[SnakeGame::STATE_SIZE];
+    double newState[SnakeGame::STATE_SIZE];
+
+    game.getGameState(state);
+    for (long i = 0; i < n; ++i) {
+      int action = rng.uniform() < 0.1 ? static_cast<int>(rng.below(4))
+                                       : nn.getAction(state);
+      game.step(static_cast<SnakeGame::Direction>(action));
+      double reward = game.calculateReward();
+      game.getGameState(newState);
+      nn.updateQValues(state, action, reward, newState, game.isGameOver(),
+                       DISCOUNT_FACTOR, LEARNING_RATE);
+
+      if (game.isGameOver()) {
+        game.reset();
+        game.getGameState(state);
+      } else {
+        std::copy_n(newState, SnakeGame::STATE_SIZE, state);
+      }
+    }
+    sink = nn.getError();
+  });
+}
+
+bool writeJson(const std::string &filename,
+               const std::vector<BenchResult> &results) {
+  std::ofstream file(filename);
+  if (!file) {
+    std::cerr << "Error opening file for writing: " << filename << std::endl;
+    return false;
+  }
+
+  // One benchmark per line, which readBaseline() relies on
+  file << "{\n  \"kernels\": \"" << kernels().name << "\",\n";
+  file << "  \"benchmarks\": [\n";
+  for (size_t i = 0; i < results.size(); ++i) {
+    const BenchResult &r = results[i];
+    char line[256];
+    std::snprintf(line, sizeof(line),
+                  "    {\"name\": \"%s\", \"ns_per_op\": %.3f, "
+                  "\"min_ns_per_op\": %.3f, \"ops_per_sec\": %.1f, "
+                  "\"iterations\": %ld}%s\n",
+                  r.name.c_str(), r.nsPerOp, r.minNsPerOp, 1e9 / r.nsPerOp,
+                  r.iterations, i + 1 < results.size() ? "," : "");
+    file << line;
+  }
+  file << "  ]\n}\n";
+  return static_cast<bool>(file);
+}
+
+// ns_per_op by benchmark name from a file written by writeJson()
+bool readBaseline(const std::string &filename,
+                  std::map<std::string, double> &baseline) {
+  std::ifstream file(filename);
+  if (!file) {
+    std::cerr << "Error opening file for reading: " << filename << std::endl;
+    return false;
+  }
+
+  const std::string nameKey = "\"name\": \"";
+  const std::string timeKey = "\"ns_per_op\": ";
+  std::string line;
+  while (std::getline(file, line)) {
+    size_t name = line.find(nameKey);
+    size_t time = line.find(timeKey);
+    if (name == std::string::npos || time == std::string::npos) {
+      continue;
+    }
+    name += nameKey.size();
+    baseline[line.substr(name, line.find('"', name) - name)] =
+        std::strtod(line.c_str() + time + timeKey.size(), nullptr);
+  }
+  return true;
+}
+
+// Number of benchmarks slower than baseline by more than threshold
+int compareBaseline(const std::vector<BenchResult> &results,
+                    const std::map<std::string, double> &baseline,
+                    double threshold) {
+  int regressions = 0;
+  for (const BenchResult &r : results) {
+    auto it = baseline.find(r.name);
+    if (it == baseline.end() || it->second <= 0.0) {
+      continue;
+    }
+    double change = r.nsPerOp / it->second - 1.0;
+    bool regressed = change > threshold;
+    regressions += regressed;
+    std::printf("%-28s %+7.1f%% vs baseline (%.1f ns/op)%s\n", r.name.c_str(),
+                100.0 * change, it->second, regressed ? "  REGRESSION" : "");
+  }
+  return regressions;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  BenchOptions options;
+  for (int i = 1; i < argc; ++i) {
+    std::string opt = argv[i];
+    if (opt == "--filter" && i + 1 < argc) {
+      options.filter = argv[++i];
+    } else if (opt == "--min-time" && i + 1 < argc) {
+      options.minTime = std::stod(argv[++i]);
+    } else if (opt == "--repetitions" && i + 1 < argc) {
+      options.repetitions = std::max(1, std::stoi(argv[++i]));
+    } else if (opt == "--json" && i + 1 < argc) {
+      options.jsonFile = argv[++i];
+    } else if (opt == "--baseline" && i + 1 < argc) {
+      options.baselineFile = argv[++i];
+    } else if (opt == "--threshold" && i + 1 < argc) {
+      options.threshold = std::stod(argv[++i]);
+    } else {
+      std::cerr << "Unknown option: " << opt << std::endl;
+      return 2;
+    }
+  }
+
+  std::map<std::string, double> baseline;
+  if (!options.baselineFile.empty() &&
+      !readBaseline(options.baselineFile, baseline)) {
+    return 2;
+  }
+
+  std::printf("Kernels: %s\n", kernels().name);
+  Bench bench(options);
+  benchSimulation(bench);
+  for (const std::vector<int> &topology :
+       {NETWORK_TOPOLOGY, std::vector<int>{8, 64, 4},
+        std::vector<int>{8, 256, 256, 4}}) {
+    benchNetwork(bench, topology);
+  }
+  benchFixedNetwork(bench);
+  benchTraining(bench);
+
+  if (!options.jsonFile.empty() &&
+      !writeJson(options.jsonFile, bench.getResults())) {
+    return 2;
+  }
+
+  if (!baseline.empty() &&
+      compareBaseline(bench.getResults(), baseline, options.threshold) > 0) {
+    return 1;
+  }
+  return 0;
+}
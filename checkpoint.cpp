@@ -0,0 +1,204 @@
+#include "checkpoint.h"
+#include "nn.h"
+#include "weights_file.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <utility>
+
+namespace {
+
+constexpr char CHECKPOINT_MAGIC[8] = {'S', 'N', 'A', 'K', 'E', 'C', 'K', 'P'};
+constexpr uint32_t CHECKPOINT_VERSION = 1;
+
+// Checkpoint file name for episode; zero padded so names sort by episode
+std::string checkpointName(const std::string &prefix, long episode) {
+  char number[32];
+  std::snprintf(number, sizeof(number), ".%08ld.bin", episode);
+  return prefix + number;
+}
+
+// Checkpoints under prefix as (episode, path), oldest first
+std::vector<std::pair<long, std::string>>
+listCheckpoints(const std::string &prefix) {
+  namespace fs = std::filesystem;
+
+  fs::path base(prefix);
+  fs::path dir = base.has_parent_path() ? base.parent_path() : fs::path(".");
+  std::string stem = base.filename().string() + ".";
+
+  std::vector<std::pair<long, std::string>> found;
+  std::error_code error;
+  for (const fs::directory_entry &entry : fs::directory_iterator(dir, error)) {
+    std::string name = entry.path().filename().string();
+    if (name.size() <= stem.size() + 4 || name.compare(0, stem.size(), stem) ||
+        name.compare(name.size() - 4, 4, ".bin")) {
+      continue;
+    }
+    std::string number = name.substr(stem.size(), name.size() - stem.size() - 4);
+    if (number.find_first_not_of("0123456789") != std::string::npos) {
+      continue;
+    }
+    found.emplace_back(std::stol(number), (base.parent_path() / name).string());
+  }
+  std::sort(found.begin(), found.end());
+  return found;
+}
+
+} // namespace
+
+Checkpointer::Checkpointer(const std::string &prefix,
+                           const std::string &weightsFile, int keep)
+    : prefix(prefix), weightsFile(weightsFile),
+      keep(static_cast<size_t>(std::max(keep, 1))) {
+  for (const auto &checkpoint : listCheckpoints(prefix)) {
+    written.push_back(checkpoint.second);
+  }
+  thread = std::thread(&Checkpointer::run, this);
+}
+
+Checkpointer::~Checkpointer() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_one();
+  thread.join();
+}
+
+void Checkpointer::save(const NeuralNetwork &nn,
+                        const TrainingProgress &progress) {
+  const AlignedVector &targetWeights = nn.getTargetWeightBuffer();
+  const AlignedVector &targetBiases = nn.getTargetBiasBuffer();
+
+  CheckpointState state{};
+  std::memcpy(state.magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+  state.version = CHECKPOINT_VERSION;
+  state.hasTarget = !targetWeights.empty();
+  state.episode = progress.episode;
+  state.totalSteps = progress.totalSteps;
+  state.explorationRate = progress.explorationRate;
+  state.updatesSinceSync = nn.getUpdatesSinceSync();
+
+  // Copy under the lock; the I/O thread only reads pending after swapping
+  // it out, so this is the only time training waits
+  std::lock_guard<std::mutex> lock(mutex);
+  pending.topology = nn.getTopology();
+  pending.weights = nn.getWeightBuffer();
+  pending.biases = nn.getBiasBuffer();
+  pending.extra.resize(sizeof(state) / sizeof(double) + targetWeights.size() +
+                       targetBiases.size());
+  std::memcpy(pending.extra.data(), &state, sizeof(state));
+  std::copy(targetWeights.begin(), targetWeights.end(),
+            pending.extra.begin() + sizeof(state) / sizeof(double));
+  std::copy(targetBiases.begin(), targetBiases.end(),
+            pending.extra.end() - targetBiases.size());
+  pending.episode = progress.episode;
+  hasPending = true;
+  wake.notify_one();
+}
+
+void Checkpointer::flush() {
+  std::unique_lock<std::mutex> lock(mutex);
+  idle.wait(lock, [this] { return !hasPending && !busy; });
+}
+
+void Checkpointer::run() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    wake.wait(lock, [this] { return hasPending || stopping; });
+    if (!hasPending) {
+      break;
+    }
+
+    std::swap(pending, writing);
+    hasPending = false;
+    busy = true;
+    lock.unlock();
+
+    write(writing);
+
+    lock.lock();
+    busy = false;
+    idle.notify_all();
+  }
+}
+
+void Checkpointer::write(const Snapshot &snapshot) {
+  std::string name = checkpointName(prefix, snapshot.episode);
+  if (!WeightsFile::save(name, snapshot.topology, snapshot.weights.data(),
+                         snapshot.weights.size(), snapshot.biases.data(),
+                         snapshot.biases.size(), snapshot.extra.data(),
+                         snapshot.extra.size() * sizeof(double))) {
+    return;
+  }
+  WeightsFile::save(weightsFile, snapshot.topology, snapshot.weights.data(),
+                    snapshot.weights.size(), snapshot.biases.data(),
+                    snapshot.biases.size());
+
+  // Roll: drop the oldest checkpoints beyond keep. Rewriting an episode
+  // (e.g. the final save) makes it the newest.
+  written.erase(std::remove(written.begin(), written.end(), name),
+                written.end());
+  written.push_back(name);
+  while (written.size() > keep) {
+    std::remove(written.front().c_str());
+    written.pop_front();
+  }
+}
+
+bool Checkpointer::resume(const std::string &prefix, NeuralNetwork &nn,
+                          TrainingProgress &progress) {
+  std::vector<std::pair<long, std::string>> checkpoints =
+      listCheckpoints(prefix);
+
+  // Newest first
+  for (auto it = checkpoints.rbegin(); it != checkpoints.rend(); ++it) {
+    const std::string &name = it->second;
+    WeightsFile file;
+    if (!file.open(name)) {
+      continue;
+    }
+
+    CheckpointState state;
+    if (file.extraSize() < sizeof(state)) {
+      std::cerr << "Not a checkpoint: " << name << std::endl;
+      continue;
+    }
+    std::memcpy(&state, file.extraData(), sizeof(state));
+    if (std::memcmp(state.magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) !=
+            0 ||
+        state.version != CHECKPOINT_VERSION ||
+        (state.hasTarget &&
+         file.extraSize() != sizeof(state) + (file.weightCount() +
+                                              file.biasCount()) *
+                                                 sizeof(double))) {
+      std::cerr << "Unsupported checkpoint: " << name << std::endl;
+      continue;
+    }
+    if (!nn.loadWeights(file)) {
+      continue;
+    }
+
+    // Without a saved target network, the freshly synced one is kept
+    if (state.hasTarget && !nn.getTargetWeightBuffer().empty()) {
+      const double *target = reinterpret_cast<const double *>(
+          static_cast<const char *>(file.extraData()) + sizeof(state));
+      nn.restoreTargetNetwork(target, target + file.weightCount(),
+                              static_cast<int>(state.updatesSinceSync));
+    }
+
+    progress.episode = state.episode;
+    progress.totalSteps = state.totalSteps;
+    progress.explorationRate = state.explorationRate;
+    std::cout << "Resumed from " << name << " (episode " << progress.episode
+              << ", step " << progress.totalSteps << ")" << std::endl;
+    return true;
+  }
+
+  std::cerr << "No usable checkpoint found for " << prefix << std::endl;
+  return false;
+}
@@ -0,0 +1,99 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "aligned.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class NeuralNetwork;
+
+// Training progress stored with each checkpoint
+struct TrainingProgress {
+  long episode = 0;    // Episodes completed
+  long totalSteps = 0; // Training steps taken
+  double explorationRate = 1.0;
+};
+
+// Training state kept in the extra section of a checkpoint's weight file
+// (weights_file.h), followed by the target network's weights and biases when
+// hasTarget is set
+struct CheckpointState {
+  char magic[8];
+  uint32_t version;
+  uint32_t hasTarget;
+  int64_t episode;
+  int64_t totalSteps;
+  double explorationRate;
+  int64_t updatesSinceSync;
+  uint8_t reserved[16];
+};
+static_assert(sizeof(CheckpointState) == CACHE_LINE,
+              "checkpoint state must fill one cache line");
+
+// Background checkpointing for the trainers. save() copies the network into
+// a snapshot and returns; an I/O thread writes it as <prefix>.<episode>.bin,
+// keeps the newest `keep` of those, and refreshes weightsFile with the plain
+// weights. Every file goes through WeightsFile::save() (temporary file,
+// fsync, rename), so a crash never leaves a torn checkpoint. If the thread
+// is still writing, a newer snapshot replaces the one waiting rather than
+// stalling training.
+class Checkpointer {
+public:
+  // Constructor and destructor. Checkpoints already under prefix count
+  // towards keep; the destructor writes any pending snapshot.
+  Checkpointer(const std::string &prefix, const std::string &weightsFile,
+               int keep);
+  ~Checkpointer();
+
+  Checkpointer(const Checkpointer &) = delete;
+  Checkpointer &operator=(const Checkpointer &) = delete;
+
+  // Queue a snapshot of nn and progress
+  void save(const NeuralNetwork &nn, const TrainingProgress &progress);
+
+  // Block until every queued snapshot is on disk
+  void flush();
+
+  // Load the newest valid checkpoint under prefix into nn, which should
+  // already have its target network enabled if training uses one. Corrupt
+  // checkpoints are skipped in favour of older ones. Restores weights, the
+  // target network and progress only; no replay or RNG state is saved.
+  static bool resume(const std::string &prefix, NeuralNetwork &nn,
+                     TrainingProgress &progress);
+
+private:
+  struct Snapshot {
+    std::vector<int> topology;
+    AlignedVector weights, biases;
+    AlignedVector extra; // CheckpointState and target network, as doubles
+    long episode = 0;
+  };
+
+  std::string prefix;
+  std::string weightsFile;
+  size_t keep;
+
+  // Checkpoint files on disk, oldest first (only touched by the I/O thread
+  // after construction)
+  std::deque<std::string> written;
+
+  // pending is filled by save(), swapped into writing by the I/O thread;
+  // buffers are reused, so steady-state saves do not allocate
+  std::mutex mutex;
+  std::condition_variable wake, idle;
+  Snapshot pending, writing;
+  bool hasPending = false;
+  bool busy = false;
+  bool stopping = false;
+  std::thread thread;
+
+  void run();
+  void write(const Snapshot &snapshot);
+};
+
+#endif // CHECKPOINT_H
@@ -0,0 +1,139 @@
+#include "evaluation.h"
+#include "snake.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Games per pool task, enough to amortize the task overhead while leaving
+// work to steal near the end
+const int GAMES_PER_TASK = 16;
+
+struct GameResult {
+  int score = 0;
+  int steps = 0;
+  SnakeGame::DeathCause cause = SnakeGame::NONE; // NONE: stopped looping
+};
+
+GameResult playGame(const SnakeNetwork &policy, SnakeGame &game,
+                    uint64_t key) {
+  game.seed(key);
+  game.reset();
+
+  GameResult result;
+  double state[SnakeGame::STATE_SIZE];
+  int sinceFood = 0;
+  while (!game.isGameOver() && sinceFood < EVAL_STEPS_WITHOUT_FOOD) {
+    game.getGameState(state);
+    int score = game.getScore();
+    game.step(static_cast<SnakeGame::Direction>(policy.getAction(state)));
+    result.steps++;
+    sinceFood = game.getScore() > score ? 0 : sinceFood + 1;
+  }
+  result.score = game.getScore();
+  result.cause = game.getDeathCause();
+  return result;
+}
+
+// Mean, median and 95th percentile (nearest rank) of values
+template <typename T>
+void summarize(std::vector<T> values, double &mean, double &median,
+               double &p95) {
+  std::sort(values.begin(), values.end());
+  double sum = 0.0;
+  for (T value : values) {
+    sum += value;
+  }
+  size_t n = values.size();
+  mean = sum / n;
+  median = n % 2 ? values[n / 2] : 0.5 * (values[n / 2 - 1] + values[n / 2]);
+  p95 = values[std::max<size_t>(1, (95 * n + 99) / 100) - 1];
+}
+
+} // namespace
+
+EvalStats evaluatePolicy(const SnakeNetwork &policy,
+                         const EvalOptions &options) {
+  EvalStats stats;
+  if (options.games <= 0) {
+    return stats;
+  }
+
+  size_t threads = options.threads > 0
+                       ? static_cast<size_t>(options.threads)
+                       : std::max(1u, std::thread::hardware_concurrency());
+  std::vector<GameResult> results(options.games);
+
+  auto start = std::chrono::steady_clock::now();
+  {
+    WorkStealingPool pool(threads);
+    for (int first = 0; first < options.games; first += GAMES_PER_TASK) {
+      pool.submit([&, first] {
+        SnakeGame game(20, 40, 0);
+        int last = std::min(first + GAMES_PER_TASK, options.games);
+        for (int i = first; i < last; ++i) {
+          results[i] = playGame(
+              policy, game, Rng::streamKey(options.seed, Stream::GAME, i));
+        }
+      });
+    }
+    pool.wait();
+  }
+  stats.seconds = std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+
+  std::vector<int> scores, steps;
+  for (const GameResult &result : results) {
+    scores.push_back(result.score);
+    steps.push_back(result.steps);
+    stats.totalSteps += result.steps;
+    stats.maxScore = std::max(stats.maxScore, result.score);
+    switch (result.cause) {
+    case SnakeGame::WALL:
+      stats.wallDeaths++;
+      break;
+    case SnakeGame::SELF:
+      stats.selfDeaths++;
+      break;
+    case SnakeGame::BOARD_FULL:
+      stats.boardFull++;
+      break;
+    default:
+      stats.looping++;
+    }
+  }
+  stats.games = options.games;
+  summarize(scores, stats.meanScore, stats.medianScore, stats.p95Score);
+  summarize(steps, stats.meanSteps, stats.medianSteps, stats.p95Steps);
+  return stats;
+}
+
+void printEvalStats(const EvalStats &stats, std::FILE *out) {
+  if (stats.games == 0) {
+    std::fprintf(out, "No games played\n");
+    return;
+  }
+
+  auto percent = [&](int count) { return 100.0 * count / stats.games; };
+  std::fprintf(out, "Games:    %d\n", stats.games);
+  std::fprintf(out, "Score:    mean %.2f, median %.1f, p95 %.0f, max %d\n",
+               stats.meanScore, stats.medianScore, stats.p95Score,
+               stats.maxScore);
+  std::fprintf(out, "Steps:    mean %.1f, median %.1f, p95 %.0f\n",
+               stats.meanSteps, stats.medianSteps, stats.p95Steps);
+  std::fprintf(out,
+               "Endings:  wall %d (%.1f%%), self %d (%.1f%%), "
+               "board full %d (%.1f%%), looping %d (%.1f%%)\n",
+               stats.wallDeaths, percent(stats.wallDeaths), stats.selfDeaths,
+               percent(stats.selfDeaths), stats.boardFull,
+               percent(stats.boardFull), stats.looping,
+               percent(stats.looping));
+  std::fprintf(out, "Speed:    %ld steps in %.3f s (%.0f steps/s)\n",
+               stats.totalSteps, stats.seconds,
+               stats.seconds > 0.0 ? stats.totalSteps / stats.seconds : 0.0);
+}
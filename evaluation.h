@@ -0,0 +1,46 @@
+#ifndef EVALUATION_H
+#define EVALUATION_H
+
+#include "training.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+// Headless evaluation of the greedy policy of a trained network: many seeded
+// games played in parallel, summarized by score, episode length and how the
+// games ended. Game i places food from stream i of the seed (rng.h), so a
+// given seed and game count always plays the same games whatever the thread
+// count.
+
+// A game that goes this many steps without eating is stopped and counted as
+// looping (greedy policies can circle forever)
+const int EVAL_STEPS_WITHOUT_FOOD = 1000;
+
+// Command line options for evaluation
+struct EvalOptions {
+  int games = 1000;
+  uint64_t seed = 1; // (--seed)
+  int threads = 0;   // 0 uses every core (--threads)
+};
+
+struct EvalStats {
+  int games = 0;
+  double meanScore = 0.0, medianScore = 0.0, p95Score = 0.0;
+  int maxScore = 0;
+  double meanSteps = 0.0, medianSteps = 0.0, p95Steps = 0.0;
+
+  // How the games ended
+  int wallDeaths = 0, selfDeaths = 0, boardFull = 0, looping = 0;
+
+  long totalSteps = 0;
+  double seconds = 0.0;
+};
+
+// Play options.games games with policy
+EvalStats evaluatePolicy(const SnakeNetwork &policy,
+                         const EvalOptions &options);
+
+// Print stats as a short report
+void printEvalStats(const EvalStats &stats, std::FILE *out = stdout);
+
+#endif // EVALUATION_H
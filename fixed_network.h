@@ -0,0 +1,154 @@
+#ifndef FIXED_NETWORK_H
+#define FIXED_NETWORK_H
+
+#include "nn.h"
+#include "weights_file.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace fixed_network {
+
+// Sigmoid of every element, inlined with the array's constant length rather
+// than dispatched to a runtime-sized kernel
+template <size_t N> void sigmoid(std::array<double, N> &x) {
+  for (double &v : x) {
+    v = 1.0 / (1.0 + std::exp(-v));
+  }
+}
+
+// One fully connected layer, weights row-major per output neuron. Each dot
+// product is split over LANES independent partial sums, a fixed shape the
+// compiler turns into vector code without reassociating anything itself.
+template <int In, int Out> struct Layer {
+  static constexpr int LANES = 4;
+  static constexpr int ROW = (In + LANES - 1) / LANES * LANES; // Zero padded
+
+  std::array<double, Out * ROW> weights{};
+  std::array<double, Out> biases{};
+
+  // out = W * in + b
+  void apply(const double *in, double *out) const {
+    std::array<double, ROW> x{};
+    std::copy_n(in, In, x.begin());
+
+    for (int n = 0; n < Out; ++n) {
+      const double *row = &weights[n * ROW];
+      double lanes[LANES] = {};
+      for (int i = 0; i < ROW; i += LANES) {
+        for (int l = 0; l < LANES; ++l) {
+          lanes[l] += row[i + l] * x[i + l];
+        }
+      }
+      out[n] = biases[n] + ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3]));
+    }
+  }
+
+  // Copy layer index of source (a NeuralNetwork or WeightsFile)
+  template <typename Source> void assign(const Source &source, size_t index) {
+    const double *w = source.getWeights(index);
+    for (int n = 0; n < Out; ++n) {
+      std::copy_n(w + n * source.getStride(index), In, &weights[n * ROW]);
+    }
+    std::copy_n(source.getBiases(index), Out, biases.begin());
+  }
+};
+
+// The layers from In onwards, nested one per member
+template <int In, int Out, int... Rest> struct Layers {
+  Layer<In, Out> layer;
+  Layers<Out, Rest...> rest;
+
+  // Output layer weighted sums; hidden layers are activated with sigmoid
+  void forward(const double *in, double *out) const {
+    std::array<double, Out> hidden;
+    layer.apply(in, hidden.data());
+    sigmoid(hidden);
+    rest.forward(hidden.data(), out);
+  }
+
+  template <typename Source> void assign(const Source &source, size_t index) {
+    layer.assign(source, index);
+    rest.assign(source, index + 1);
+  }
+};
+
+template <int In, int Out> struct Layers<In, Out> {
+  Layer<In, Out> layer;
+
+  void forward(const double *in, double *out) const { layer.apply(in, out); }
+
+  template <typename Source> void assign(const Source &source, size_t index) {
+    layer.assign(source, index);
+  }
+};
+
+} // namespace fixed_network
+
+// Inference network whose layer sizes are compile-time constants, e.g.
+// FixedNetwork<8, 16, 4>. Weights live in std::arrays inside the object and
+// every loop has a constant trip count. It is built from a trained
+// NeuralNetwork or read from a weight file, and computes the same
+// function (up to rounding).
+template <int... Sizes> class FixedNetwork {
+  static_assert(sizeof...(Sizes) >= 2, "a network needs at least two layers");
+
+public:
+  static constexpr int INPUTS = std::array<int, sizeof...(Sizes)>{Sizes...}[0];
+  static constexpr int OUTPUTS =
+      std::array<int, sizeof...(Sizes)>{Sizes...}[sizeof...(Sizes) - 1];
+
+  // Layer sizes as NeuralNetwork takes them
+  static std::vector<int> topology() { return {Sizes...}; }
+
+  // Constructors. The default network has all weights zero.
+  FixedNetwork() = default;
+  explicit FixedNetwork(const NeuralNetwork &nn) { assign(nn); }
+
+  // Copy the weights of a NeuralNetwork or an open WeightsFile, which must
+  // have the same topology
+  template <typename Source> bool assign(const Source &source) {
+    if (source.getTopology() != topology()) {
+      std::cerr << "Topology mismatch. Cannot copy weights." << std::endl;
+      return false;
+    }
+    layers.assign(source, 0);
+    return true;
+  }
+
+  // Load weights saved by NeuralNetwork::saveWeights(). Current files are
+  // copied straight out of the mapping; legacy files go through a
+  // NeuralNetwork.
+  bool loadWeights(const std::string &filename) {
+    if (WeightsFile::isLegacy(filename)) {
+      NeuralNetwork nn(topology());
+      return nn.loadWeights(filename) && assign(nn);
+    }
+    WeightsFile file;
+    return file.open(filename) && assign(file);
+  }
+
+  // Forward propagation
+  std::array<double, OUTPUTS> feedForward(const double *inputs) const {
+    std::array<double, OUTPUTS> outputs;
+    layers.forward(inputs, outputs.data());
+    fixed_network::sigmoid(outputs);
+    return outputs;
+  }
+
+  // Get the predicted action. Sigmoid is monotonic, so the output layer is
+  // left unactivated.
+  int getAction(const double *gameState) const {
+    std::array<double, OUTPUTS> outputs;
+    layers.forward(gameState, outputs.data());
+    return std::max_element(outputs.begin(), outputs.end()) - outputs.begin();
+  }
+
+private:
+  fixed_network::Layers<Sizes...> layers;
+};
+
+#endif // FIXED_NETWORK_H
@@ -0,0 +1,379 @@
+#include "inference.h"
+#include "kernels.h"
+#include "nn.h"
+#include "rng.h"
+#include "snake.h"
+#include "weights_file.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Totals of a padded buffer layout
+struct LayoutSize {
+  size_t neurons = 0;
+  size_t weights = 0;
+  size_t biases = 0;
+};
+
+// Same layout as NeuralNetwork, with rows padded to a cache line of T
+template <typename T>
+LayoutSize layOut(const std::vector<int> &topology, std::vector<size_t> &stride,
+                  std::vector<size_t> &neuronOffset,
+                  std::vector<size_t> &weightOffset,
+                  std::vector<size_t> &biasOffset) {
+  size_t layerCount = topology.size();
+  stride.resize(layerCount);
+  neuronOffset.resize(layerCount);
+  weightOffset.resize(layerCount - 1);
+  biasOffset.resize(layerCount - 1);
+
+  LayoutSize size;
+  for (size_t i = 0; i < layerCount; ++i) {
+    stride[i] = padToLineOf<T>(topology[i]);
+    neuronOffset[i] = size.neurons;
+    size.neurons += stride[i];
+  }
+  for (size_t layer = 0; layer + 1 < layerCount; ++layer) {
+    weightOffset[layer] = size.weights;
+    size.weights += topology[layer + 1] * stride[layer];
+    biasOffset[layer] = size.biases;
+    size.biases += stride[layer + 1];
+  }
+  return size;
+}
+
+// Round x to the nearest integer, saturating at +-limit
+int32_t roundClamped(float x, float limit) {
+  x = std::min(limit, std::max(-limit, x));
+  return static_cast<int32_t>(x < 0.0f ? x - 0.5f : x + 0.5f);
+}
+
+// Quantize an activation to uint8 given 1 / scale and the zero point
+uint8_t quantizeActivation(float x, float invScale, int32_t zero) {
+  float q = std::min(255.0f, std::max(0.0f, x * invScale + zero));
+  return static_cast<uint8_t>(q + 0.5f);
+}
+
+// Double precision forward pass: acts[layer] receives the inputs of every
+// weight layer and acts.back() the output layer's weighted sums
+void forwardReference(const NeuralNetwork &nn, const double *state,
+                      std::vector<std::vector<double>> &acts) {
+  const std::vector<int> &topology = nn.getTopology();
+  size_t outputLayer = topology.size() - 1;
+  acts.resize(topology.size());
+  acts[0].assign(state, state + topology[0]);
+
+  for (size_t layer = 0; layer < outputLayer; ++layer) {
+    const double *w = nn.getWeights(layer);
+    const double *b = nn.getBiases(layer);
+    std::vector<double> &next = acts[layer + 1];
+    next.resize(topology[layer + 1]);
+    for (int n = 0; n < topology[layer + 1]; ++n) {
+      const double *row = w + n * nn.getStride(layer);
+      double sum = b[n];
+      for (int i = 0; i < topology[layer]; ++i) {
+        sum += row[i] * acts[layer][i];
+      }
+      next[n] = layer + 1 < outputLayer ? 1.0 / (1.0 + std::exp(-sum)) : sum;
+    }
+  }
+}
+
+template <typename Engine>
+InferenceAccuracy compare(NeuralNetwork &reference, Engine &engine,
+                          const double *states, size_t count) {
+  size_t inputCount = reference.getTopology().front();
+  size_t outputCount = reference.getTopology().back();
+
+  InferenceAccuracy accuracy;
+  accuracy.samples = count;
+  if (count == 0) {
+    return accuracy;
+  }
+
+  size_t agreed = 0;
+  double errorSum = 0.0;
+  for (size_t i = 0; i < count; ++i) {
+    const double *state = states + i * inputCount;
+    agreed += reference.getAction(state) == engine.getAction(state);
+
+    const double *expected = reference.feedForward(state);
+    const auto *actual = engine.feedForward(state);
+    for (size_t o = 0; o < outputCount; ++o) {
+      double error = std::abs(actual[o] - expected[o]);
+      accuracy.maxOutputError = std::max(accuracy.maxOutputError, error);
+      errorSum += error;
+    }
+  }
+
+  accuracy.actionAgreement = static_cast<double>(agreed) / count;
+  accuracy.meanOutputError = errorSum / (count * outputCount);
+  return accuracy;
+}
+
+} // namespace
+
+FloatNetwork::FloatNetwork(const NeuralNetwork &nn)
+    : topology(nn.getTopology()) {
+  LayoutSize size = layOut<float>(topology, stride, neuronOffset,
+                                  weightOffset, biasOffset);
+  neurons.assign(size.neurons, 0.0f);
+  weights.assign(size.weights, 0.0f);
+  biases.assign(size.biases, 0.0f);
+
+  for (size_t layer = 0; layer + 1 < topology.size(); ++layer) {
+    const double *w = nn.getWeights(layer);
+    const double *b = nn.getBiases(layer);
+    for (int n = 0; n < topology[layer + 1]; ++n) {
+      float *row = &weights[weightOffset[layer] + n * stride[layer]];
+      for (int i = 0; i < topology[layer]; ++i) {
+        row[i] = static_cast<float>(w[n * nn.getStride(layer) + i]);
+      }
+      biases[biasOffset[layer] + n] = static_cast<float>(b[n]);
+    }
+  }
+}
+
+void FloatNetwork::forwardPass(const double *inputs) {
+  float *input = &neurons[neuronOffset[0]];
+  for (int i = 0; i < topology[0]; ++i) {
+    input[i] = static_cast<float>(inputs[i]);
+  }
+
+  const Kernels &k = kernels();
+  size_t outputLayer = topology.size() - 1;
+  for (size_t layer = 0; layer < outputLayer; ++layer) {
+    float *out = &neurons[neuronOffset[layer + 1]];
+    k.matVecF32(&weights[weightOffset[layer]], stride[layer],
+                topology[layer + 1], &neurons[neuronOffset[layer]],
+                &biases[biasOffset[layer]], out);
+    if (layer + 1 < outputLayer) {
+      k.sigmoidF32(topology[layer + 1], out);
+    }
+  }
+}
+
+const float *FloatNetwork::feedForward(const double *inputs) {
+  forwardPass(inputs);
+
+  float *output = &neurons[neuronOffset.back()];
+  kernels().sigmoidF32(topology.back(), output);
+  return output;
+}
+
+int FloatNetwork::getAction(const double *gameState) {
+  // Sigmoid is monotonic, so the weighted sums give the same argmax
+  forwardPass(gameState);
+  const float *output = &neurons[neuronOffset.back()];
+  return std::max_element(output, output + topology.back()) - output;
+}
+
+QuantizedNetwork::QuantizedNetwork(const NeuralNetwork &nn,
+                                   const double *states, size_t count)
+    : topology(nn.getTopology()) {
+  LayoutSize size = layOut<int8_t>(topology, stride, neuronOffset,
+                                   weightOffset, biasOffset);
+  neurons.assign(size.neurons, 0);
+  outputs.assign(topology.back(), 0.0f);
+  weights.assign(size.weights, 0);
+  biases.assign(size.biases, 0.0f);
+  outputScale.assign(size.biases, 0.0f);
+  int widest = *std::max_element(topology.begin(), topology.end());
+  dots.assign(widest, 0);
+  sums.assign(widest, 0.0f);
+  weightSum.assign(size.biases, 0);
+
+  // Calibrate every layer's input quantization: the observed range,
+  // widened to include zero, maps onto 0..255
+  size_t outputLayer = topology.size() - 1;
+  std::vector<double> low(outputLayer, 0.0), high(outputLayer, 0.0);
+  std::vector<std::vector<double>> acts;
+  for (size_t s = 0; s < count; ++s) {
+    forwardReference(nn, states + s * topology[0], acts);
+    for (size_t layer = 0; layer < outputLayer; ++layer) {
+      for (double a : acts[layer]) {
+        low[layer] = std::min(low[layer], a);
+        high[layer] = std::max(high[layer], a);
+      }
+    }
+  }
+
+  inputScale.resize(outputLayer);
+  inputZero.resize(outputLayer);
+  for (size_t layer = 0; layer < outputLayer; ++layer) {
+    double width = high[layer] - low[layer];
+    inputScale[layer] = width > 0.0 ? width / 255.0 : 1.0f;
+    inputZero[layer] = roundClamped(-low[layer] / inputScale[layer], 255.0f);
+  }
+
+  // Quantize each weight row with its own scale
+  for (size_t layer = 0; layer + 1 < topology.size(); ++layer) {
+    const double *w = nn.getWeights(layer);
+    const double *b = nn.getBiases(layer);
+    for (int n = 0; n < topology[layer + 1]; ++n) {
+      const double *row = w + n * nn.getStride(layer);
+      double maxWeight = 0.0;
+      for (int i = 0; i < topology[layer]; ++i) {
+        maxWeight = std::max(maxWeight, std::abs(row[i]));
+      }
+      float scale = maxWeight > 0.0 ? maxWeight / 127.0 : 1.0f;
+
+      int8_t *qrow = &weights[weightOffset[layer] + n * stride[layer]];
+      size_t index = biasOffset[layer] + n;
+      for (int i = 0; i < topology[layer]; ++i) {
+        qrow[i] = roundClamped(row[i] / scale, 127.0f);
+        weightSum[index] += qrow[i];
+      }
+      biases[index] = static_cast<float>(b[n]);
+      outputScale[index] = scale * inputScale[layer];
+    }
+  }
+
+  // Bias correction: the rounding error is largely systematic, so shift the
+  // output biases by the mean error over the calibration states
+  if (count > 0) {
+    std::vector<double> error(topology.back(), 0.0);
+    for (size_t s = 0; s < count; ++s) {
+      const double *state = states + s * topology[0];
+      forwardReference(nn, state, acts);
+      forwardPass(state);
+      for (int o = 0; o < topology.back(); ++o) {
+        error[o] += acts.back()[o] - outputs[o];
+      }
+    }
+
+    float *b = &biases[biasOffset[outputLayer - 1]];
+    for (int o = 0; o < topology.back(); ++o) {
+      b[o] += error[o] / count;
+    }
+  }
+}
+
+void QuantizedNetwork::forwardPass(const double *inputs) {
+  uint8_t *input = &neurons[neuronOffset[0]];
+  for (int i = 0; i < topology[0]; ++i) {
+    input[i] = quantizeActivation(inputs[i], 1.0f / inputScale[0],
+                                  inputZero[0]);
+  }
+
+  const Kernels &k = kernels();
+  size_t outputLayer = topology.size() - 1;
+  for (size_t layer = 0; layer < outputLayer; ++layer) {
+    int count = topology[layer + 1];
+    k.matVecI8(&weights[weightOffset[layer]], stride[layer], count,
+               &neurons[neuronOffset[layer]], dots.data());
+
+    // Back to real values, removing the zero point
+    const int32_t *wsum = &weightSum[biasOffset[layer]];
+    const float *scale = &outputScale[biasOffset[layer]];
+    const float *b = &biases[biasOffset[layer]];
+    int32_t zero = inputZero[layer];
+    float *out = layer + 1 < outputLayer ? sums.data() : outputs.data();
+    for (int n = 0; n < count; ++n) {
+      out[n] = (dots[n] - zero * wsum[n]) * scale[n] + b[n];
+    }
+
+    // Activate and quantize the next layer's inputs
+    if (layer + 1 < outputLayer) {
+      k.sigmoidF32(count, out);
+      uint8_t *next = &neurons[neuronOffset[layer + 1]];
+      float invScale = 1.0f / inputScale[layer + 1];
+      for (int n = 0; n < count; ++n) {
+        next[n] = quantizeActivation(out[n], invScale, inputZero[layer + 1]);
+      }
+    }
+  }
+}
+
+const float *QuantizedNetwork::feedForward(const double *inputs) {
+  forwardPass(inputs);
+
+  kernels().sigmoidF32(outputs.size(), outputs.data());
+  return outputs.data();
+}
+
+int QuantizedNetwork::getAction(const double *gameState) {
+  forwardPass(gameState);
+  return std::max_element(outputs.begin(), outputs.end()) - outputs.begin();
+}
+
+MappedNetwork::MappedNetwork(std::shared_ptr<const WeightsFile> file)
+    : file(std::move(file)) {
+  const std::vector<int> &topology = this->file->getTopology();
+  size_t total = 0;
+  for (int neurons : topology) {
+    neuronOffset.push_back(total);
+    total += padToLine(neurons);
+  }
+  neurons.assign(total, 0.0);
+}
+
+void MappedNetwork::forwardPass(const double *inputs) {
+  const std::vector<int> &topology = file->getTopology();
+  std::copy_n(inputs, topology[0], &neurons[neuronOffset[0]]);
+
+  // Same kernels as NeuralNetwork, over the file's padded rows
+  const Kernels &k = kernels();
+  size_t outputLayer = topology.size() - 1;
+  for (size_t layer = 0; layer < outputLayer; ++layer) {
+    double *out = &neurons[neuronOffset[layer + 1]];
+    k.matVec(file->getWeights(layer), file->getStride(layer),
+             topology[layer + 1], &neurons[neuronOffset[layer]],
+             file->getBiases(layer), out);
+    if (layer + 1 < outputLayer) {
+      k.sigmoid(topology[layer + 1], out);
+    }
+  }
+}
+
+const double *MappedNetwork::feedForward(const double *inputs) {
+  forwardPass(inputs);
+
+  double *outputs = &neurons[neuronOffset.back()];
+  kernels().sigmoid(file->getTopology().back(), outputs);
+  return outputs;
+}
+
+int MappedNetwork::getAction(const double *gameState) {
+  forwardPass(gameState);
+  const double *outputs = &neurons[neuronOffset.back()];
+  return std::max_element(outputs, outputs + file->getTopology().back()) -
+         outputs;
+}
+
+InferenceAccuracy checkAccuracy(NeuralNetwork &reference, FloatNetwork &engine,
+                                const double *states, size_t count) {
+  return compare(reference, engine, states, count);
+}
+
+InferenceAccuracy checkAccuracy(NeuralNetwork &reference,
+                                QuantizedNetwork &engine, const double *states,
+                                size_t count) {
+  return compare(reference, engine, states, count);
+}
+
+InferenceAccuracy checkAccuracy(NeuralNetwork &reference,
+                                MappedNetwork &engine, const double *states,
+                                size_t count) {
+  return compare(reference, engine, states, count);
+}
+
+std::vector<double> recordStates(NeuralNetwork &nn, int games, int maxSteps,
+                                 uint64_t seed) {
+  std::vector<double> states;
+  SnakeGame game(20, 40, 0);
+  double state[SnakeGame::STATE_SIZE];
+
+  for (int g = 0; g < games; ++g) {
+    game.seed(Rng::streamKey(seed, Stream::GAME, g));
+    game.reset();
+    for (int step = 0; step < maxSteps && !game.isGameOver(); ++step) {
+      game.getGameState(state);
+      states.insert(states.end(), state, state + SnakeGame::STATE_SIZE);
+      game.step(static_cast<SnakeGame::Direction>(nn.getAction(state)));
+    }
+  }
+  return states;
+}
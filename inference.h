@@ -0,0 +1,133 @@
+#ifndef INFERENCE_H
+#define INFERENCE_H
+
+#include "aligned.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class NeuralNetwork;
+class WeightsFile;
+
+// Reduced precision copies of a trained NeuralNetwork for playing. Both
+// engines are read-only snapshots: retrain the network and build a new one
+// to pick up new weights. Buffers are padded to whole cache lines like
+// NeuralNetwork's, with zero padding.
+
+// Single precision inference
+class FloatNetwork {
+public:
+  // Constructor
+  explicit FloatNetwork(const NeuralNetwork &nn);
+
+  // Q-values for one game state. The result stays valid until the next call.
+  const float *feedForward(const double *inputs);
+
+  // Get the predicted action
+  int getAction(const double *gameState);
+
+private:
+  std::vector<int> topology;
+  std::vector<size_t> stride;
+  std::vector<size_t> neuronOffset, weightOffset, biasOffset;
+  AlignedFloatVector neurons;
+  AlignedFloatVector weights;
+  AlignedFloatVector biases;
+
+  // Run every layer, leaving the output layer as weighted sums
+  void forwardPass(const double *inputs);
+};
+
+// Post-training int8 quantization. Weights are quantized symmetrically to
+// int8 per output neuron. Each layer's inputs are quantized to uint8 with a
+// scale and zero point calibrated from the range of activations seen on a
+// set of recorded game states. Dot products accumulate in int32 and are
+// rescaled to float for the bias and sigmoid.
+class QuantizedNetwork {
+public:
+  // Quantize nn, calibrating on count game states stored row-major
+  QuantizedNetwork(const NeuralNetwork &nn, const double *states,
+                   size_t count);
+
+  // Q-values for one game state. The result stays valid until the next call.
+  const float *feedForward(const double *inputs);
+
+  // Get the predicted action
+  int getAction(const double *gameState);
+
+private:
+  std::vector<int> topology;
+  std::vector<size_t> stride;
+  std::vector<size_t> neuronOffset, weightOffset, biasOffset;
+
+  // Quantized activations feeding each layer, the float output layer, and
+  // scratch for one layer's dot products and their real values
+  AlignedUint8Vector neurons;
+  std::vector<float> outputs;
+  std::vector<int32_t> dots;
+  std::vector<float> sums;
+
+  AlignedInt8Vector weights;
+  std::vector<float> biases;
+
+  // Scale and zero point of each layer's quantized inputs. Per output
+  // neuron, the sum of its quantized weights (to remove the zero point) and
+  // the factor turning an int32 dot product back into a real value.
+  std::vector<float> inputScale;
+  std::vector<int32_t> inputZero;
+  std::vector<int32_t> weightSum;
+  std::vector<float> outputScale;
+
+  // Run every layer, leaving outputs as weighted sums
+  void forwardPass(const double *inputs);
+};
+
+// Double precision inference reading the weights in place from a mapped
+// weight file (weights_file.h), which it keeps open. Nothing is copied at
+// load time, and processes playing with the same file share its pages.
+class MappedNetwork {
+public:
+  // Constructor; file must be open
+  explicit MappedNetwork(std::shared_ptr<const WeightsFile> file);
+
+  // Q-values for one game state. The result stays valid until the next call.
+  const double *feedForward(const double *inputs);
+
+  // Get the predicted action
+  int getAction(const double *gameState);
+
+private:
+  std::shared_ptr<const WeightsFile> file;
+  std::vector<size_t> neuronOffset;
+  AlignedVector neurons;
+
+  // Run every layer, leaving the output layer as weighted sums
+  void forwardPass(const double *inputs);
+};
+
+// Agreement of an inference engine with the double precision network
+struct InferenceAccuracy {
+  size_t samples = 0;
+  double actionAgreement = 0.0; // Fraction of states with the same action
+  double maxOutputError = 0.0;  // Largest absolute Q-value difference
+  double meanOutputError = 0.0; // Mean absolute Q-value difference
+};
+
+// Compare engine against reference on count game states stored row-major
+InferenceAccuracy checkAccuracy(NeuralNetwork &reference, FloatNetwork &engine,
+                                const double *states, size_t count);
+InferenceAccuracy checkAccuracy(NeuralNetwork &reference,
+                                QuantizedNetwork &engine, const double *states,
+                                size_t count);
+InferenceAccuracy checkAccuracy(NeuralNetwork &reference,
+                                MappedNetwork &engine, const double *states,
+                                size_t count);
+
+// Game states visited by nn playing games greedily (each game capped at
+// maxSteps), for calibration and accuracy checks. Game g places food from
+// stream g of the run seed (rng.h).
+std::vector<double> recordStates(NeuralNetwork &nn, int games, int maxSteps,
+                                 uint64_t seed);
+
+#endif // INFERENCE_H
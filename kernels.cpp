@@ -0,0 +1,597 @@
+#include "kernels.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SNAKE_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// exp() is evaluated as 2^n * e^r with n = round(x / ln2) and |r| <= ln2/2.
+// e^r uses its Taylor series up to r^11, whose truncation error is below
+// 1e-13 on that interval. Inputs are clamped so 2^n stays a normal double;
+// sigmoid is saturated well before the clamp is reached.
+constexpr double EXP_CLAMP = 40.0;
+constexpr double LOG2E = 1.4426950408889634;
+constexpr double LN2_HI = 6.93145751953125e-1;
+constexpr double LN2_LO = 1.42860682030941723212e-6;
+constexpr double EXP_POLY[] = {1.0 / 39916800, 1.0 / 3628800, 1.0 / 362880,
+                               1.0 / 40320,    1.0 / 5040,    1.0 / 720,
+                               1.0 / 120,      1.0 / 24,      1.0 / 6,
+                               1.0 / 2,        1.0,           1.0};
+
+double expApprox(double x) {
+  x = std::fmin(std::fmax(x, -EXP_CLAMP), EXP_CLAMP);
+  double n = std::nearbyint(x * LOG2E);
+  double r = x - n * LN2_HI - n * LN2_LO;
+  double p = EXP_POLY[0];
+  for (size_t i = 1; i < sizeof(EXP_POLY) / sizeof(EXP_POLY[0]); ++i) {
+    p = p * r + EXP_POLY[i];
+  }
+  return std::ldexp(p, static_cast<int>(n));
+}
+
+double sigmoidApprox(double x) { return 1.0 / (1.0 + expApprox(-x)); }
+
+// Single precision exp: same reduction, Taylor series up to r^7 (truncation
+// error below 1e-8)
+constexpr float EXPF_CLAMP = 80.0f;
+constexpr float LOG2EF = 1.44269504f;
+constexpr float LN2F_HI = 0.693359375f;
+constexpr float LN2F_LO = -2.12194440e-4f;
+constexpr float EXPF_POLY[] = {1.0f / 5040, 1.0f / 720, 1.0f / 120, 1.0f / 24,
+                               1.0f / 6,    1.0f / 2,   1.0f,       1.0f};
+
+float expApproxF32(float x) {
+  x = std::fmin(std::fmax(x, -EXPF_CLAMP), EXPF_CLAMP);
+  float n = std::nearbyint(x * LOG2EF);
+  float r = x - n * LN2F_HI - n * LN2F_LO;
+  float p = EXPF_POLY[0];
+  for (size_t i = 1; i < sizeof(EXPF_POLY) / sizeof(EXPF_POLY[0]); ++i) {
+    p = p * r + EXPF_POLY[i];
+  }
+  return std::ldexp(p, static_cast<int>(n));
+}
+
+float sigmoidApproxF32(float x) { return 1.0f / (1.0f + expApproxF32(-x)); }
+
+// Scalar kernels
+
+void matVecScalar(const double *w, size_t stride, size_t rows, const double *x,
+                  const double *bias, double *y) {
+  for (size_t r = 0; r < rows; ++r) {
+    const double *row = w + r * stride;
+    double sum = bias[r];
+    for (size_t i = 0; i < stride; ++i) {
+      sum += row[i] * x[i];
+    }
+    y[r] = sum;
+  }
+}
+
+void axpyScalar(size_t n, double a, const double *x, double *y) {
+  for (size_t i = 0; i < n; ++i) {
+    y[i] += a * x[i];
+  }
+}
+
+void sigmoidScalar(size_t n, double *x) {
+  for (size_t i = 0; i < n; ++i) {
+    x[i] = sigmoidApprox(x[i]);
+  }
+}
+
+void matVecF32Scalar(const float *w, size_t stride, size_t rows,
+                     const float *x, const float *bias, float *y) {
+  for (size_t r = 0; r < rows; ++r) {
+    const float *row = w + r * stride;
+    float sum = bias[r];
+    for (size_t i = 0; i < stride; ++i) {
+      sum += row[i] * x[i];
+    }
+    y[r] = sum;
+  }
+}
+
+void matVecI8Scalar(const int8_t *w, size_t stride, size_t rows,
+                    const uint8_t *x, int32_t *y) {
+  for (size_t r = 0; r < rows; ++r) {
+    const int8_t *row = w + r * stride;
+    int32_t sum = 0;
+    for (size_t i = 0; i < stride; ++i) {
+      sum += static_cast<int32_t>(row[i]) * x[i];
+    }
+    y[r] = sum;
+  }
+}
+
+void sigmoidF32Scalar(size_t n, float *x) {
+  for (size_t i = 0; i < n; ++i) {
+    x[i] = sigmoidApproxF32(x[i]);
+  }
+}
+
+// Portable GEMM: 4x8 register tiles, B streamed one packed row at a time
+void gemmScalar(const double *a, size_t lda, size_t m, size_t depth,
+                const double *b, size_t ldb, const double *bias, double *c,
+                size_t ldc) {
+  for (size_t r0 = 0; r0 < m; r0 += 4) {
+    size_t rows = m - r0 < 4 ? m - r0 : 4;
+    for (size_t j0 = 0; j0 < ldb; j0 += 8) {
+      double acc[4][8];
+      for (size_t r = 0; r < rows; ++r) {
+        for (size_t j = 0; j < 8; ++j) {
+          acc[r][j] = bias[j0 + j];
+        }
+      }
+      for (size_t k = 0; k < depth; ++k) {
+        const double *brow = b + k * ldb + j0;
+        for (size_t r = 0; r < rows; ++r) {
+          double av = a[(r0 + r) * lda + k];
+          for (size_t j = 0; j < 8; ++j) {
+            acc[r][j] += av * brow[j];
+          }
+        }
+      }
+      for (size_t r = 0; r < rows; ++r) {
+        for (size_t j = 0; j < 8; ++j) {
+          c[(r0 + r) * ldc + j0 + j] = acc[r][j];
+        }
+      }
+    }
+  }
+}
+
+#ifdef SNAKE_X86
+
+// SSE2 kernels (baseline on x86-64)
+
+double hsum(__m128d v) {
+  return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v)));
+}
+
+void matVecSse2(const double *w, size_t stride, size_t rows, const double *x,
+                const double *bias, double *y) {
+  for (size_t r = 0; r < rows; ++r) {
+    const double *row = w + r * stride;
+    __m128d acc0 = _mm_setzero_pd(), acc1 = _mm_setzero_pd();
+    for (size_t i = 0; i < stride; i += 4) {
+      acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_load_pd(row + i),
+                                         _mm_load_pd(x + i)));
+      acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_load_pd(row + i + 2),
+                                         _mm_load_pd(x + i + 2)));
+    }
+    y[r] = bias[r] + hsum(_mm_add_pd(acc0, acc1));
+  }
+}
+
+void axpySse2(size_t n, double a, const double *x, double *y) {
+  __m128d av = _mm_set1_pd(a);
+  for (size_t i = 0; i < n; i += 2) {
+    __m128d yv = _mm_load_pd(y + i);
+    _mm_store_pd(y + i, _mm_add_pd(yv, _mm_mul_pd(av, _mm_load_pd(x + i))));
+  }
+}
+
+void sigmoidSse2(size_t n, double *x) {
+  const __m128d clamp = _mm_set1_pd(EXP_CLAMP);
+  const __m128d one = _mm_set1_pd(1.0);
+  size_t i = 0;
+  for (; i + 2 <= n; i += 2) {
+    // t = -x, clamped
+    __m128d t = _mm_sub_pd(_mm_setzero_pd(), _mm_loadu_pd(x + i));
+    t = _mm_min_pd(_mm_max_pd(t, _mm_sub_pd(_mm_setzero_pd(), clamp)), clamp);
+
+    __m128i ni = _mm_cvtpd_epi32(_mm_mul_pd(t, _mm_set1_pd(LOG2E)));
+    __m128d n = _mm_cvtepi32_pd(ni);
+    __m128d r = _mm_sub_pd(t, _mm_mul_pd(n, _mm_set1_pd(LN2_HI)));
+    r = _mm_sub_pd(r, _mm_mul_pd(n, _mm_set1_pd(LN2_LO)));
+
+    __m128d p = _mm_set1_pd(EXP_POLY[0]);
+    for (size_t k = 1; k < sizeof(EXP_POLY) / sizeof(EXP_POLY[0]); ++k) {
+      p = _mm_add_pd(_mm_mul_pd(p, r), _mm_set1_pd(EXP_POLY[k]));
+    }
+
+    // 2^n built directly in the exponent field
+    __m128i biased = _mm_add_epi32(ni, _mm_set1_epi32(1023));
+    __m128i pow2 =
+        _mm_slli_epi64(_mm_unpacklo_epi32(biased, _mm_setzero_si128()), 52);
+    __m128d e = _mm_mul_pd(p, _mm_castsi128_pd(pow2));
+
+    _mm_storeu_pd(x + i, _mm_div_pd(one, _mm_add_pd(one, e)));
+  }
+  for (; i < n; ++i) {
+    x[i] = sigmoidApprox(x[i]);
+  }
+}
+
+// AVX2 + FMA kernels
+
+__attribute__((target("avx2,fma"))) void
+matVecAvx2(const double *w, size_t stride, size_t rows, const double *x,
+           const double *bias, double *y) {
+  size_t r = 0;
+
+  // Four rows at a time, reduced together with horizontal adds
+  for (; r + 4 <= rows; r += 4) {
+    const double *w0 = w + r * stride;
+    const double *w1 = w0 + stride;
+    const double *w2 = w1 + stride;
+    const double *w3 = w2 + stride;
+    __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+    __m256d acc2 = _mm256_setzero_pd(), acc3 = _mm256_setzero_pd();
+    for (size_t i = 0; i < stride; i += 4) {
+      __m256d xv = _mm256_load_pd(x + i);
+      acc0 = _mm256_fmadd_pd(_mm256_load_pd(w0 + i), xv, acc0);
+      acc1 = _mm256_fmadd_pd(_mm256_load_pd(w1 + i), xv, acc1);
+      acc2 = _mm256_fmadd_pd(_mm256_load_pd(w2 + i), xv, acc2);
+      acc3 = _mm256_fmadd_pd(_mm256_load_pd(w3 + i), xv, acc3);
+    }
+    __m256d t0 = _mm256_hadd_pd(acc0, acc1);
+    __m256d t1 = _mm256_hadd_pd(acc2, acc3);
+    __m256d sum = _mm256_add_pd(_mm256_permute2f128_pd(t0, t1, 0x21),
+                                _mm256_blend_pd(t0, t1, 0xC));
+    _mm256_storeu_pd(y + r, _mm256_add_pd(sum, _mm256_loadu_pd(bias + r)));
+  }
+
+  for (; r < rows; ++r) {
+    const double *row = w + r * stride;
+    __m256d acc = _mm256_setzero_pd();
+    for (size_t i = 0; i < stride; i += 4) {
+      acc = _mm256_fmadd_pd(_mm256_load_pd(row + i), _mm256_load_pd(x + i),
+                            acc);
+    }
+    __m128d half = _mm_add_pd(_mm256_castpd256_pd128(acc),
+                              _mm256_extractf128_pd(acc, 1));
+    y[r] = bias[r] + hsum(half);
+  }
+}
+
+__attribute__((target("avx2,fma"))) void axpyAvx2(size_t n, double a,
+                                                  const double *x, double *y) {
+  __m256d av = _mm256_set1_pd(a);
+  for (size_t i = 0; i < n; i += 4) {
+    _mm256_store_pd(y + i, _mm256_fmadd_pd(av, _mm256_load_pd(x + i),
+                                           _mm256_load_pd(y + i)));
+  }
+}
+
+__attribute__((target("avx2,fma"))) void sigmoidAvx2(size_t n, double *x) {
+  const __m256d clamp = _mm256_set1_pd(EXP_CLAMP);
+  const __m256d one = _mm256_set1_pd(1.0);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256d t = _mm256_sub_pd(_mm256_setzero_pd(), _mm256_loadu_pd(x + i));
+    t = _mm256_min_pd(
+        _mm256_max_pd(t, _mm256_sub_pd(_mm256_setzero_pd(), clamp)), clamp);
+
+    __m128i ni = _mm256_cvtpd_epi32(_mm256_mul_pd(t, _mm256_set1_pd(LOG2E)));
+    __m256d n4 = _mm256_cvtepi32_pd(ni);
+    __m256d r = _mm256_fnmadd_pd(n4, _mm256_set1_pd(LN2_HI), t);
+    r = _mm256_fnmadd_pd(n4, _mm256_set1_pd(LN2_LO), r);
+
+    __m256d p = _mm256_set1_pd(EXP_POLY[0]);
+    for (size_t k = 1; k < sizeof(EXP_POLY) / sizeof(EXP_POLY[0]); ++k) {
+      p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(EXP_POLY[k]));
+    }
+
+    __m256i biased =
+        _mm256_cvtepi32_epi64(_mm_add_epi32(ni, _mm_set1_epi32(1023)));
+    __m256d pow2 = _mm256_castsi256_pd(_mm256_slli_epi64(biased, 52));
+    __m256d e = _mm256_mul_pd(p, pow2);
+
+    _mm256_storeu_pd(x + i, _mm256_div_pd(one, _mm256_add_pd(one, e)));
+  }
+  for (; i < n; ++i) {
+    x[i] = sigmoidApprox(x[i]);
+  }
+}
+
+__attribute__((target("avx2,fma"))) void
+matVecF32Avx2(const float *w, size_t stride, size_t rows, const float *x,
+              const float *bias, float *y) {
+  for (size_t r = 0; r < rows; ++r) {
+    const float *row = w + r * stride;
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    for (size_t i = 0; i < stride; i += 16) {
+      acc0 = _mm256_fmadd_ps(_mm256_load_ps(row + i), _mm256_load_ps(x + i),
+                             acc0);
+      acc1 = _mm256_fmadd_ps(_mm256_load_ps(row + i + 8),
+                             _mm256_load_ps(x + i + 8), acc1);
+    }
+    __m256 acc = _mm256_add_ps(acc0, acc1);
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(acc),
+                             _mm256_extractf128_ps(acc, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+    y[r] = bias[r] + _mm_cvtss_f32(half);
+  }
+}
+
+__attribute__((target("avx2,fma"))) void
+matVecI8Avx2(const int8_t *w, size_t stride, size_t rows, const uint8_t *x,
+             int32_t *y) {
+  for (size_t r = 0; r < rows; ++r) {
+    const int8_t *row = w + r * stride;
+    __m256i acc = _mm256_setzero_si256();
+
+    // Widen 16 values at a time to int16; madd sums adjacent products into
+    // int32 lanes. (maddubs would take the uint8 x int8 pairs directly but
+    // saturates at int16.)
+    for (size_t i = 0; i < stride; i += 16) {
+      __m256i wv = _mm256_cvtepi8_epi16(
+          _mm_load_si128(reinterpret_cast<const __m128i *>(row + i)));
+      __m256i xv = _mm256_cvtepu8_epi16(
+          _mm_load_si128(reinterpret_cast<const __m128i *>(x + i)));
+      acc = _mm256_add_epi32(acc, _mm256_madd_epi16(wv, xv));
+    }
+    __m128i half = _mm_add_epi32(_mm256_castsi256_si128(acc),
+                                 _mm256_extracti128_si256(acc, 1));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4E));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xB1));
+    y[r] = _mm_cvtsi128_si32(half);
+  }
+}
+
+__attribute__((target("avx2,fma"))) void sigmoidF32Avx2(size_t n, float *x) {
+  const __m256 clamp = _mm256_set1_ps(EXPF_CLAMP);
+  const __m256 one = _mm256_set1_ps(1.0f);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 t = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(x + i));
+    t = _mm256_min_ps(
+        _mm256_max_ps(t, _mm256_sub_ps(_mm256_setzero_ps(), clamp)), clamp);
+
+    __m256 n8 = _mm256_round_ps(_mm256_mul_ps(t, _mm256_set1_ps(LOG2EF)),
+                                _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256 r = _mm256_fnmadd_ps(n8, _mm256_set1_ps(LN2F_HI), t);
+    r = _mm256_fnmadd_ps(n8, _mm256_set1_ps(LN2F_LO), r);
+
+    __m256 p = _mm256_set1_ps(EXPF_POLY[0]);
+    for (size_t k = 1; k < sizeof(EXPF_POLY) / sizeof(EXPF_POLY[0]); ++k) {
+      p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(EXPF_POLY[k]));
+    }
+
+    __m256i biased =
+        _mm256_add_epi32(_mm256_cvtps_epi32(n8), _mm256_set1_epi32(127));
+    __m256 pow2 = _mm256_castsi256_ps(_mm256_slli_epi32(biased, 23));
+    __m256 e = _mm256_mul_ps(p, pow2);
+
+    _mm256_storeu_ps(x + i, _mm256_div_ps(one, _mm256_add_ps(one, e)));
+  }
+  for (; i < n; ++i) {
+    x[i] = sigmoidApproxF32(x[i]);
+  }
+}
+
+__attribute__((target("avx2,fma"))) void
+gemmAvx2(const double *a, size_t lda, size_t m, size_t depth, const double *b,
+         size_t ldb, const double *bias, double *c, size_t ldc) {
+  size_t r0 = 0;
+
+  // 4x8 tiles: eight accumulators, each B row loaded once per four A rows
+  for (; r0 + 4 <= m; r0 += 4) {
+    const double *a0 = a + r0 * lda;
+    const double *a1 = a0 + lda;
+    const double *a2 = a1 + lda;
+    const double *a3 = a2 + lda;
+    for (size_t j0 = 0; j0 < ldb; j0 += 8) {
+      __m256d bl = _mm256_loadu_pd(bias + j0);
+      __m256d bh = _mm256_loadu_pd(bias + j0 + 4);
+      __m256d c0l = bl, c0h = bh, c1l = bl, c1h = bh;
+      __m256d c2l = bl, c2h = bh, c3l = bl, c3h = bh;
+      for (size_t k = 0; k < depth; ++k) {
+        const double *brow = b + k * ldb + j0;
+        __m256d b0 = _mm256_loadu_pd(brow);
+        __m256d b1 = _mm256_loadu_pd(brow + 4);
+        __m256d av = _mm256_broadcast_sd(a0 + k);
+        c0l = _mm256_fmadd_pd(av, b0, c0l);
+        c0h = _mm256_fmadd_pd(av, b1, c0h);
+        av = _mm256_broadcast_sd(a1 + k);
+        c1l = _mm256_fmadd_pd(av, b0, c1l);
+        c1h = _mm256_fmadd_pd(av, b1, c1h);
+        av = _mm256_broadcast_sd(a2 + k);
+        c2l = _mm256_fmadd_pd(av, b0, c2l);
+        c2h = _mm256_fmadd_pd(av, b1, c2h);
+        av = _mm256_broadcast_sd(a3 + k);
+        c3l = _mm256_fmadd_pd(av, b0, c3l);
+        c3h = _mm256_fmadd_pd(av, b1, c3h);
+      }
+      double *crow = c + r0 * ldc + j0;
+      _mm256_storeu_pd(crow, c0l);
+      _mm256_storeu_pd(crow + 4, c0h);
+      _mm256_storeu_pd(crow + ldc, c1l);
+      _mm256_storeu_pd(crow + ldc + 4, c1h);
+      _mm256_storeu_pd(crow + 2 * ldc, c2l);
+      _mm256_storeu_pd(crow + 2 * ldc + 4, c2h);
+      _mm256_storeu_pd(crow + 3 * ldc, c3l);
+      _mm256_storeu_pd(crow + 3 * ldc + 4, c3h);
+    }
+  }
+
+  if (r0 < m) {
+    gemmScalar(a + r0 * lda, lda, m - r0, depth, b, ldb, bias, c + r0 * ldc,
+               ldc);
+  }
+}
+
+// AVX-512 kernels. GCC's AVX-512 intrinsic headers trip
+// -Wmaybe-uninitialized on their own placeholder operands (in the reductions,
+// roundscale and scalef), so the warning is off for these functions only.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+__attribute__((target("avx512f"))) void
+matVecAvx512(const double *w, size_t stride, size_t rows, const double *x,
+             const double *bias, double *y) {
+  size_t r = 0;
+  for (; r + 4 <= rows; r += 4) {
+    const double *w0 = w + r * stride;
+    const double *w1 = w0 + stride;
+    const double *w2 = w1 + stride;
+    const double *w3 = w2 + stride;
+    __m512d acc0 = _mm512_setzero_pd(), acc1 = _mm512_setzero_pd();
+    __m512d acc2 = _mm512_setzero_pd(), acc3 = _mm512_setzero_pd();
+    for (size_t i = 0; i < stride; i += 8) {
+      __m512d xv = _mm512_load_pd(x + i);
+      acc0 = _mm512_fmadd_pd(_mm512_load_pd(w0 + i), xv, acc0);
+      acc1 = _mm512_fmadd_pd(_mm512_load_pd(w1 + i), xv, acc1);
+      acc2 = _mm512_fmadd_pd(_mm512_load_pd(w2 + i), xv, acc2);
+      acc3 = _mm512_fmadd_pd(_mm512_load_pd(w3 + i), xv, acc3);
+    }
+    y[r] = bias[r] + _mm512_reduce_add_pd(acc0);
+    y[r + 1] = bias[r + 1] + _mm512_reduce_add_pd(acc1);
+    y[r + 2] = bias[r + 2] + _mm512_reduce_add_pd(acc2);
+    y[r + 3] = bias[r + 3] + _mm512_reduce_add_pd(acc3);
+  }
+
+  for (; r < rows; ++r) {
+    const double *row = w + r * stride;
+    __m512d acc = _mm512_setzero_pd();
+    for (size_t i = 0; i < stride; i += 8) {
+      acc = _mm512_fmadd_pd(_mm512_load_pd(row + i), _mm512_load_pd(x + i),
+                            acc);
+    }
+    y[r] = bias[r] + _mm512_reduce_add_pd(acc);
+  }
+}
+
+__attribute__((target("avx512f"))) void
+axpyAvx512(size_t n, double a, const double *x, double *y) {
+  __m512d av = _mm512_set1_pd(a);
+  for (size_t i = 0; i < n; i += 8) {
+    _mm512_store_pd(y + i, _mm512_fmadd_pd(av, _mm512_load_pd(x + i),
+                                           _mm512_load_pd(y + i)));
+  }
+}
+
+__attribute__((target("avx512f"))) void sigmoidAvx512(size_t n, double *x) {
+  const __m512d clamp = _mm512_set1_pd(EXP_CLAMP);
+  const __m512d one = _mm512_set1_pd(1.0);
+  for (size_t i = 0; i < n; i += 8) {
+    // Partial final vector handled with a lane mask
+    __mmask8 mask = n - i >= 8 ? 0xFF : (__mmask8)((1u << (n - i)) - 1);
+    __m512d t = _mm512_sub_pd(_mm512_setzero_pd(),
+                              _mm512_maskz_loadu_pd(mask, x + i));
+    t = _mm512_min_pd(
+        _mm512_max_pd(t, _mm512_sub_pd(_mm512_setzero_pd(), clamp)), clamp);
+
+    __m512d n8 = _mm512_roundscale_pd(_mm512_mul_pd(t, _mm512_set1_pd(LOG2E)),
+                                      _MM_FROUND_TO_NEAREST_INT);
+    __m512d r = _mm512_fnmadd_pd(n8, _mm512_set1_pd(LN2_HI), t);
+    r = _mm512_fnmadd_pd(n8, _mm512_set1_pd(LN2_LO), r);
+
+    __m512d p = _mm512_set1_pd(EXP_POLY[0]);
+    for (size_t k = 1; k < sizeof(EXP_POLY) / sizeof(EXP_POLY[0]); ++k) {
+      p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(EXP_POLY[k]));
+    }
+    __m512d e = _mm512_scalef_pd(p, n8);
+
+    _mm512_mask_storeu_pd(x + i, mask,
+                          _mm512_div_pd(one, _mm512_add_pd(one, e)));
+  }
+}
+
+__attribute__((target("avx512f"))) void
+gemmAvx512(const double *a, size_t lda, size_t m, size_t depth,
+           const double *b, size_t ldb, const double *bias, double *c,
+           size_t ldc) {
+  size_t r0 = 0;
+
+  // 8x8 tiles: one accumulator per A row
+  for (; r0 + 8 <= m; r0 += 8) {
+    const double *arow = a + r0 * lda;
+    for (size_t j0 = 0; j0 < ldb; j0 += 8) {
+      __m512d acc[8];
+      __m512d bv = _mm512_loadu_pd(bias + j0);
+      for (int r = 0; r < 8; ++r) {
+        acc[r] = bv;
+      }
+      for (size_t k = 0; k < depth; ++k) {
+        __m512d brow = _mm512_loadu_pd(b + k * ldb + j0);
+        for (int r = 0; r < 8; ++r) {
+          acc[r] = _mm512_fmadd_pd(_mm512_set1_pd(arow[r * lda + k]), brow,
+                                   acc[r]);
+        }
+      }
+      for (int r = 0; r < 8; ++r) {
+        _mm512_storeu_pd(c + (r0 + r) * ldc + j0, acc[r]);
+      }
+    }
+  }
+
+  if (r0 < m) {
+    gemmScalar(a + r0 * lda, lda, m - r0, depth, b, ldb, bias, c + r0 * ldc,
+               ldc);
+  }
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif // SNAKE_X86
+
+// The reduced precision kernels only come in scalar and AVX2 versions; the
+// networks they run are too small for wider vectors to pay off
+const Kernels SCALAR = {"scalar",       matVecScalar,    axpyScalar,
+                        sigmoidScalar,  gemmScalar,      matVecF32Scalar,
+                        matVecI8Scalar, sigmoidF32Scalar};
+#ifdef SNAKE_X86
+const Kernels SSE2 = {"sse2",         matVecSse2,      axpySse2,
+                      sigmoidSse2,    gemmScalar,      matVecF32Scalar,
+                      matVecI8Scalar, sigmoidF32Scalar};
+const Kernels AVX2 = {"avx2",       matVecAvx2,    axpyAvx2,
+                      sigmoidAvx2,  gemmAvx2,      matVecF32Avx2,
+                      matVecI8Avx2, sigmoidF32Avx2};
+const Kernels AVX512 = {"avx512",      matVecAvx512,  axpyAvx512,
+                        sigmoidAvx512, gemmAvx512,    matVecF32Avx2,
+                        matVecI8Avx2,  sigmoidF32Avx2};
+#endif
+
+const Kernels &selectKernels() {
+  const Kernels *best = &SCALAR;
+  const char *forced = std::getenv("SNAKE_SIMD");
+
+#ifdef SNAKE_X86
+  // Candidates in increasing order of preference
+  __builtin_cpu_init();
+  const Kernels *supported[] = {
+      &SSE2,
+      __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") ? &AVX2
+                                                                      : nullptr,
+      __builtin_cpu_supports("avx512f") ? &AVX512 : nullptr};
+  for (const Kernels *k : supported) {
+    if (!k) {
+      continue;
+    }
+    if (!forced) {
+      best = k;
+    } else if (std::strcmp(forced, k->name) == 0) {
+      return *k;
+    }
+  }
+#endif
+
+  if (forced && std::strcmp(forced, "scalar") != 0) {
+    std::cerr << "SNAKE_SIMD=" << forced
+              << " is not supported on this CPU, using scalar" << std::endl;
+  }
+  return *best;
+}
+
+} // namespace
+
+const Kernels &kernels() {
+  static const Kernels &selected = selectKernels();
+  return selected;
+}
+
+const Kernels &scalarKernels() { return SCALAR; }
@@ -0,0 +1,57 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Inner loops of the neural network, implemented once per instruction set.
+// The best implementation the CPU supports is picked on first use; setting
+// the SNAKE_SIMD environment variable to scalar, sse2, avx2 or avx512
+// forces a specific (supported) one.
+//
+// Buffers follow the NeuralNetwork layout: rows are padded with zeros to a
+// whole cache line, so "stride" and "n" in matVec and axpy are multiples of
+// 8 doubles and pointers are 64-byte aligned. The float and int8 variants
+// used by the inference engines (inference.h) pad the same way, to 16 floats
+// or 64 int8 values.
+struct Kernels {
+  const char *name;
+
+  // y[r] = bias[r] + dot(w + r * stride, x) for r < rows
+  void (*matVec)(const double *w, size_t stride, size_t rows, const double *x,
+                 const double *bias, double *y);
+
+  // y[i] += a * x[i] for i < n
+  void (*axpy)(size_t n, double a, const double *x, double *y);
+
+  // x[i] = 1 / (1 + exp(-x[i])) for i < n (any n), using a polynomial exp
+  // approximation accurate to about 1e-12
+  void (*sigmoid)(size_t n, double *x);
+
+  // c[r * ldc + j] = bias[j] + sum(a[r * lda + k] * b[k * ldb + j], k < depth)
+  // for r < m and j < ldb. b is a weight matrix packed transposed (one row per
+  // input, ldb a multiple of 8) and c rows hold at least ldb entries.
+  void (*gemm)(const double *a, size_t lda, size_t m, size_t depth,
+               const double *b, size_t ldb, const double *bias, double *c,
+               size_t ldc);
+
+  // matVec in single precision
+  void (*matVecF32)(const float *w, size_t stride, size_t rows, const float *x,
+                    const float *bias, float *y);
+
+  // y[r] = dot(w + r * stride, x) for r < rows: int8 weights times uint8
+  // activations, accumulated in int32
+  void (*matVecI8)(const int8_t *w, size_t stride, size_t rows,
+                   const uint8_t *x, int32_t *y);
+
+  // sigmoid in single precision, accurate to about 1e-7
+  void (*sigmoidF32)(size_t n, float *x);
+};
+
+// Kernels selected for this CPU
+const Kernels &kernels();
+
+// Scalar reference kernels (used for tests and as the portable fallback)
+const Kernels &scalarKernels();
+
+#endif // KERNELS_H
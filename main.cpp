@@ -1,65 +1,102 @@
+#include "checkpoint.h"
+#include "evaluation.h"
+#include "inference.h"
 #include "nn.h"
+#include "profiling.h"
+#include "replay_buffer.h"
+#include "renderer.h"
 #include "snake.h"
+#include "training.h"
+#include "transition_log.h"
+#include "vec_env.h"
+#include "weights_file.h"
+#include <algorithm>
+#include <cerrno>
 #include <chrono>
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
-#include <random>
+#include <limits>
+#include <memory>
 #include <string>
-#include <thread>
-
-// Constants for RL
-const double LEARNING_RATE = 0.1;
-const double DISCOUNT_FACTOR = 0.90;
-const double EXPLORATION_RATE_START = 1.0;
-const double EXPLORATION_RATE_END = 0.01;
-const int EXPLORATION_DECAY_STEPS = 15000;
-const std::string WEIGHTS_FILE = "snake_ai_weights.bin";
+#include <utility>
+#include <vector>
 
 // Function to train the neural network
-void trainAI(int episodes) {
-  // Create neural network with topology: input_size -> hidden_size ->
-  // output_size Input: 8 neurons (see SnakeGame::getGameState()) Hidden: 16
-  // neurons Output: 4 neurons (UP, RIGHT, DOWN, LEFT)
-  NeuralNetwork nn({8, 16, 4});
+void trainAI(const TrainOptions &options) {
+  int episodes = options.episodes;
+
+  // Create neural network (see NETWORK_TOPOLOGY)
+  NeuralNetwork nn(NETWORK_TOPOLOGY,
+                   Rng::streamKey(options.seed, Stream::NETWORK_INIT));
+
+  // Optional experience replay instead of one update per transition
+  std::unique_ptr<ReplayLearner> replay;
+  if (options.replayCapacity > 0) {
+    replay = std::make_unique<ReplayLearner>(
+        options.replayCapacity, Rng::streamKey(options.seed, Stream::REPLAY),
+        options.prioritized);
+  }
 
-  std::random_device rd;
-  std::mt19937_64 rng(rd());
-  std::uniform_real_distribution<double> fdist;
-  std::uniform_int_distribution<int> idist(0, 3); // Fix the distribution range
+  // Optional recording of every transition
+  std::unique_ptr<TransitionLogWriter> recorder;
+  if (!options.recordFile.empty()) {
+    recorder = std::make_unique<TransitionLogWriter>(options.recordFile);
+    if (!recorder->isOpen()) {
+      return;
+    }
+  }
 
   // Try to load existing weights
   bool weightsLoaded = nn.loadWeights(WEIGHTS_FILE);
   if (weightsLoaded) {
     std::cout << "Loaded existing weights from " << WEIGHTS_FILE << std::endl;
   }
+  if (options.targetSync > 0) {
+    nn.enableTargetNetwork(options.targetSync, options.doubleDQN);
+  }
+
+  TrainingProgress progress;
+  if (options.resume) {
+    Checkpointer::resume(CHECKPOINT_PREFIX, nn, progress);
+  }
+  Checkpointer checkpointer(CHECKPOINT_PREFIX, WEIGHTS_FILE,
+                            options.keepCheckpoints);
+
+  double exploration_rate = progress.explorationRate;
+  long totalSteps = progress.totalSteps;
+
+  // Training runs headless: one game object is reset for every episode and
+  // nothing here touches the terminal
+  SnakeGame game(20, 40, 0);
 
-  double exploration_rate = EXPLORATION_RATE_START;
-  int totalSteps = 0;
+  // State buffers reused for every step
+  double currentState[SnakeGame::STATE_SIZE];
+  double newState[SnakeGame::STATE_SIZE];
 
   // Training loop
-  for (int episode = 0; episode < episodes; ++episode) {
-    // Initialize a NEW game environment for each episode
-    SnakeGame game(20, 40);
+  for (int episode = progress.episode; episode < episodes; ++episode) {
+    // Each episode has its own food and exploration streams, so a resumed
+    // run plays the same episodes as an uninterrupted one
+    game.seed(Rng::streamKey(options.seed, Stream::GAME, episode));
+    game.reset();
+    Rng rng(options.seed, Stream::EXPLORATION, episode);
 
     // Training stats
     int steps = 0;
     double totalReward = 0.0;
 
-    // Print episode start
-    // clear(); // Clear the screen
-    // mvprintw(23, 0, "Training Episode %d of %d (Exploration Rate: %.2f)",
-    //         episode + 1, episodes, exploration_rate);
-    // refresh();
     int lastScore = game.getScore();
     // Game loop for this episode
     while (!game.isGameOver()) {
       // Get current state
-      std::vector<double> currentState = game.getGameState();
+      game.getGameState(currentState);
 
       // Choose action with epsilon-greedy strategy
       int action;
-      if (fdist(rng) < exploration_rate) {
+      if (rng.uniform() < exploration_rate) {
         // Explore: random action
-        action = idist(rng);
+        action = static_cast<int>(rng.below(4));
       } else {
         // Exploit: best action according to Q-values
         action = nn.getAction(currentState);
@@ -99,77 +136,212 @@ void trainAI(int episodes) {
       }
       totalReward += reward;
       // Get new state
-      std::vector<double> newState = game.getGameState();
+      game.getGameState(newState);
+      if (recorder) {
+        recorder->append(currentState, action, reward, newState,
+                         game.isGameOver());
+      }
 
       // Update Q-values
-      nn.updateQValues(currentState, action, reward, newState, DISCOUNT_FACTOR,
-                       LEARNING_RATE);
-
-      // Render game for all training episodes (adjust frequency as needed)
-      // if (totalSteps % 1 == 0) { // Render every 5 steps to avoid flickering
-      //  game.render();
-      //  mvprintw(21, 0, "Episode: %d/%d  Score: %d  Steps: %d", episode + 1,
-      //           episodes, game.getScore(), steps);
-      //  refresh();
-      //  std::this_thread::sleep_for(std::chrono::milliseconds(2));
-      //}
+      if (replay) {
+        Transition t;
+        std::copy_n(currentState, SnakeGame::STATE_SIZE, t.state);
+        std::copy_n(newState, SnakeGame::STATE_SIZE, t.nextState);
+        t.action = action;
+        t.reward = reward;
+        t.done = game.isGameOver();
+        replay->observe(t, nn, DISCOUNT_FACTOR, LEARNING_RATE);
+      } else {
+        nn.updateQValues(currentState, action, reward, newState,
+                         game.isGameOver(), DISCOUNT_FACTOR, LEARNING_RATE);
+      }
 
       steps++;
       totalSteps++;
 
       // Decay exploration rate
-      exploration_rate =
-          EXPLORATION_RATE_START +
-          (EXPLORATION_RATE_END - EXPLORATION_RATE_START) *
-              std::min(1.0, (double)totalSteps / EXPLORATION_DECAY_STEPS);
-
-      // Check for user wanting to quit
-      // int key = getch();
-      // if (key == 'q' || key == 'Q') {
-      //  mvprintw(10, 10, "Training interrupted by user!");
-      //  refresh();
-      //  std::this_thread::sleep_for(std::chrono::seconds(2));
-      //  goto training_end; // Exit both loops
-      //}
+      exploration_rate = explorationRate(totalSteps);
     }
 
     // Print episode statistics
-    mvprintw(22, 0,
-             "Episode %d complete: Steps = %d, Score = %d, Total Reward = %.2f "
-             "Error: %lf",
-             episode + 1, steps, game.getScore(), totalReward, nn.getError());
-    // refresh();
-    // std::this_thread::sleep_for(
-    //     std::chrono::milliseconds(50)); // Pause between episodes
-
-    // Save weights every 5 episodes (more frequent for small training runs)
-    if (episode % 5 == 0 && episode > 0) {
-      nn.saveWeights(WEIGHTS_FILE);
-      // mvprintw(3, 1, "Weights saved to %s", WEIGHTS_FILE.c_str());
-      // refresh();
+    std::printf("Episode %d complete: Steps = %d, Score = %d, Total Reward = "
+                "%.2f Error: %lf\n",
+                episode + 1, steps, game.getScore(), totalReward,
+                nn.getError());
+
+    // Checkpoint in the background every few episodes
+    progress = {episode + 1, totalSteps, exploration_rate};
+    if (episode % CHECKPOINT_INTERVAL == 0 && episode > 0) {
+      checkpointer.save(nn, progress);
+    }
+    if ((episode + 1) % PROFILE_REPORT_INTERVAL == 0) {
+      PROFILE_REPORT();
     }
   }
 
-training_end:
   std::cout << "Total steps across all episodes: " << totalSteps << std::endl;
 
   // Final save
-  nn.saveWeights(WEIGHTS_FILE);
+  checkpointer.save(nn, progress);
+  checkpointer.flush();
+  PROFILE_REPORT();
   std::cout << "Training completed. Final weights saved to " << WEIGHTS_FILE
             << std::endl;
+}
+
+// Function to train the neural network on a pool of games stepped together.
+// States for all games are evaluated with one batched forward pass per tick.
+void trainAIVectorized(const TrainOptions &options) {
+  int episodes = options.episodes;
+  int envCount = options.envCount;
+  NeuralNetwork nn(NETWORK_TOPOLOGY,
+                   Rng::streamKey(options.seed, Stream::NETWORK_INIT));
+  Rng rng(options.seed, Stream::EXPLORATION);
+
+  std::unique_ptr<ReplayLearner> replay;
+  if (options.replayCapacity > 0) {
+    replay = std::make_unique<ReplayLearner>(
+        options.replayCapacity, Rng::streamKey(options.seed, Stream::REPLAY),
+        options.prioritized);
+  }
+
+  std::unique_ptr<TransitionLogWriter> recorder;
+  if (!options.recordFile.empty()) {
+    recorder = std::make_unique<TransitionLogWriter>(options.recordFile);
+    if (!recorder->isOpen()) {
+      return;
+    }
+  }
+
+  bool weightsLoaded = nn.loadWeights(WEIGHTS_FILE);
+  if (weightsLoaded) {
+    std::cout << "Loaded existing weights from " << WEIGHTS_FILE << std::endl;
+  }
+  if (options.targetSync > 0) {
+    nn.enableTargetNetwork(options.targetSync, options.doubleDQN);
+  }
+
+  TrainingProgress progress;
+  if (options.resume) {
+    Checkpointer::resume(CHECKPOINT_PREFIX, nn, progress);
+  }
+  Checkpointer checkpointer(CHECKPOINT_PREFIX, WEIGHTS_FILE,
+                            options.keepCheckpoints);
+
+  VecSnakeEnv env(envCount, 20, 40, options.seed);
+  const size_t stateSize = VecSnakeEnv::STATE_SIZE;
+
+  // Per-tick buffers, allocated once
+  std::vector<double> states(envCount * stateSize);
+  std::vector<double> nextStates(envCount * stateSize);
+  std::vector<double> rewards(envCount);
+  std::vector<uint8_t> dones(envCount);
+  std::vector<int> actions(envCount);
+  std::vector<int> lastScores(envCount, 0);
+  std::vector<double> totalRewards(envCount, 0.0);
+
+  double exploration_rate = progress.explorationRate;
+  long totalSteps = progress.totalSteps;
+  int episode = progress.episode;
+
+  while (episode < episodes) {
+    env.getStates(states.data());
+
+    // Exploit for every game at once, then replace with random actions
+    // where exploring
+    nn.getActionBatch(states.data(), envCount, actions.data());
+    for (int i = 0; i < envCount; ++i) {
+      if (rng.uniform() < exploration_rate) {
+        actions[i] = static_cast<int>(rng.below(4));
+      }
+    }
+
+    env.step(actions.data(), nextStates.data(), rewards.data(), dones.data());
+
+    for (int i = 0; i < envCount && episode < episodes; ++i) {
+      // Same starvation penalty as trainAI(), using the step count before
+      // this step
+      int score = dones[i] ? env.getFinishedScore(i) : env.getScore(i);
+      int steps = (dones[i] ? env.getFinishedSteps(i) : env.getSteps(i)) - 1;
+      double reward = rewards[i];
+      if (reward == 1.0) {
+        lastScores[i] = score;
+      }
+      if (steps % 100 == 0 && lastScores[i] == score) {
+        reward += -1.0;
+      }
+      totalRewards[i] += reward;
+      if (recorder) {
+        recorder->append(&states[i * stateSize], actions[i], reward,
+                         &nextStates[i * stateSize], dones[i]);
+      }
+
+      if (replay) {
+        Transition t;
+        std::copy_n(&states[i * stateSize], stateSize, t.state);
+        std::copy_n(&nextStates[i * stateSize], stateSize, t.nextState);
+        t.action = actions[i];
+        t.reward = reward;
+        t.done = dones[i];
+        replay->observe(t, nn, DISCOUNT_FACTOR, LEARNING_RATE);
+      } else {
+        nn.updateQValues(&states[i * stateSize], actions[i], reward,
+                         &nextStates[i * stateSize], dones[i],
+                         DISCOUNT_FACTOR, LEARNING_RATE);
+      }
+
+      totalSteps++;
+      exploration_rate = explorationRate(totalSteps);
+
+      if (dones[i]) {
+        std::printf("Episode %d complete: Steps = %d, Score = %d, Total "
+                    "Reward = %.2f Error: %lf\n",
+                    episode + 1, steps + 1, score, totalRewards[i],
+                    nn.getError());
+        lastScores[i] = 0;
+        totalRewards[i] = 0.0;
+
+        progress = {episode + 1, totalSteps, exploration_rate};
+        if (episode % CHECKPOINT_INTERVAL == 0 && episode > 0) {
+          checkpointer.save(nn, progress);
+        }
+        if ((episode + 1) % PROFILE_REPORT_INTERVAL == 0) {
+          PROFILE_REPORT();
+        }
+        episode++;
+      }
+    }
+  }
 
-  // Wait for key press before exiting
-  mvprintw(5, 1, "Training complete. Press any key to continue...");
-  refresh();
-  nodelay(stdscr, FALSE); // Wait for key press
-  getch();
-  nodelay(stdscr, TRUE); // Reset to non-blocking mode
+  std::cout << "Total steps across all episodes: " << totalSteps << std::endl;
+
+  checkpointer.save(nn, progress);
+  checkpointer.flush();
+  PROFILE_REPORT();
+  std::cout << "Training completed. Final weights saved to " << WEIGHTS_FILE
+            << std::endl;
 }
 
-// Function to let AI play the game
-void aiPlay() {
+// Games and steps per game recorded to calibrate and check reduced precision
+// inference
+const int CALIBRATION_GAMES = 20;
+const int CALIBRATION_STEPS = 500;
+
+// Run seeds of those games (see recordStates()). The accuracy check uses
+// other games than the int8 calibration.
+const uint64_t CALIBRATION_SEED = 1;
+const uint64_t VALIDATION_SEED = 2;
+
+// Function to let AI play the game. precision selects the inference engine:
+// double (a compile-time specialized copy of the trained network), mapped
+// (double, read in place from the mapped weight file), float or int8; loop sets
+// the tick and frame rates or fast-forward. With a recordFile, the game's
+// transitions are appended to that log.
+void aiPlay(const std::string &precision,
+            const LoopOptions &loop = LoopOptions(),
+            const std::string &recordFile = "") {
   // Create neural network with same topology
-  NeuralNetwork nn({8, 16, 4});
+  NeuralNetwork nn(NETWORK_TOPOLOGY);
 
   // Load trained weights
   if (!nn.loadWeights(WEIGHTS_FILE)) {
@@ -178,77 +350,346 @@ void aiPlay() {
     return;
   }
 
+  SnakeNetwork fixed(nn);
+
+  // Reduced precision engines are checked against the double network on
+  // states from a few headless games before playing
+  std::unique_ptr<MappedNetwork> mapped;
+  std::unique_ptr<FloatNetwork> single;
+  std::unique_ptr<QuantizedNetwork> quantized;
+  if (precision != "double") {
+    std::vector<double> validation =
+        recordStates(nn, CALIBRATION_GAMES, CALIBRATION_STEPS, VALIDATION_SEED);
+    size_t count = validation.size() / SnakeGame::STATE_SIZE;
+
+    InferenceAccuracy accuracy;
+    if (precision == "mapped") {
+      auto file = std::make_shared<WeightsFile>();
+      if (!file->open(WEIGHTS_FILE)) {
+        return;
+      }
+      if (file->getTopology() != NETWORK_TOPOLOGY) {
+        std::cerr << "Topology mismatch. Cannot load weights." << std::endl;
+        return;
+      }
+      mapped = std::make_unique<MappedNetwork>(std::move(file));
+      accuracy = checkAccuracy(nn, *mapped, validation.data(), count);
+    } else if (precision == "float") {
+      single = std::make_unique<FloatNetwork>(nn);
+      accuracy = checkAccuracy(nn, *single, validation.data(), count);
+    } else if (precision == "int8") {
+      std::vector<double> calibration =
+          recordStates(nn, CALIBRATION_GAMES, CALIBRATION_STEPS,
+                       CALIBRATION_SEED);
+      quantized = std::make_unique<QuantizedNetwork>(
+          nn, calibration.data(), calibration.size() / SnakeGame::STATE_SIZE);
+      accuracy = checkAccuracy(nn, *quantized, validation.data(), count);
+    } else {
+      std::cerr << "Unknown precision: " << precision << std::endl;
+      return;
+    }
+
+    std::printf("%s inference: %.2f%% action agreement, max Q error %.2e "
+                "(mean %.2e) over %zu states\n",
+                precision.c_str(), 100.0 * accuracy.actionAgreement,
+                accuracy.maxOutputError, accuracy.meanOutputError,
+                accuracy.samples);
+  }
+
+  std::unique_ptr<TransitionLogWriter> recorder;
+  if (!recordFile.empty()) {
+    recorder = std::make_unique<TransitionLogWriter>(recordFile);
+    if (!recorder->isOpen()) {
+      return;
+    }
+  }
+
   std::cout << "AI is playing Snake. Press 'q' to quit." << std::endl;
 
   // Initialize game
   SnakeGame game(20, 40);
+  SnakeRenderer renderer(game);
+
+  // Steer with the chosen engine every tick; actions are directions. A
+  // tick's transition is recorded on the next tick (or at the end), once its
+  // reward and next state are known.
+  double state[SnakeGame::STATE_SIZE];
+  double previousState[SnakeGame::STATE_SIZE];
+  int previousAction = -1;
+  auto policy = [&](SnakeGame &playing) {
+    playing.getGameState(state);
+    if (recorder && previousAction >= 0) {
+      recorder->append(previousState, previousAction,
+                       playing.calculateReward(), state, false);
+    }
 
-  // Game loop
-  while (!game.isGameOver()) {
-    // Get current state
-    std::vector<double> state = game.getGameState();
-
-    // Choose action
-    int action = nn.getAction(state);
-
-    // Convert action index to direction
-    SnakeGame::Direction direction;
-    switch (action) {
-    case 0:
-      direction = SnakeGame::UP;
-      break;
-    case 1:
-      direction = SnakeGame::RIGHT;
-      break;
-    case 2:
-      direction = SnakeGame::DOWN;
-      break;
-    case 3:
-      direction = SnakeGame::LEFT;
-      break;
-    default:
-      direction = SnakeGame::RIGHT;
+    int action = quantized ? quantized->getAction(state)
+                 : single  ? single->getAction(state)
+                 : mapped  ? mapped->getAction(state)
+                           : fixed.getAction(state);
+    playing.setDirection(static_cast<SnakeGame::Direction>(action));
+
+    std::copy_n(state, SnakeGame::STATE_SIZE, previousState);
+    previousAction = action;
+  };
+
+  if (renderer.run(loop, policy)) {
+    if (recorder && previousAction >= 0) {
+      game.getGameState(state);
+      recorder->append(previousState, previousAction, game.calculateReward(),
+                       state, true);
     }
+    renderer.showGameOver();
+  }
+}
 
-    // Take action
-    game.setDirection(direction);
+// Train on a recorded transition log instead of playing: passes sweeps over
+// the log in minibatches, read straight from the mapping. Each pass visits
+// the transitions in a fresh random order from the seed's replay stream.
+// targetSync > 0 enables a target network synced that often.
+void trainFromLog(const std::string &logFile, int passes, uint64_t seed,
+                  int targetSync) {
+  TransitionLog log;
+  if (!log.open(logFile)) {
+    return;
+  }
 
-    // Check for user input to quit
-    int key = getch();
-    if (key == 'q' || key == 'Q') {
-      break;
-    }
+  NeuralNetwork nn(NETWORK_TOPOLOGY,
+                   Rng::streamKey(seed, Stream::NETWORK_INIT));
+  if (nn.loadWeights(WEIGHTS_FILE)) {
+    std::cout << "Loaded existing weights from " << WEIGHTS_FILE << std::endl;
+  }
+  if (targetSync > 0) {
+    nn.enableTargetNetwork(targetSync);
+  }
+
+  const size_t batchSize = ReplayLearner::BATCH_SIZE;
+  Minibatch batch;
+  batch.resize(batchSize);
 
-    // Update and render the game
-    game.update();
-    game.render();
+  std::vector<size_t> order(log.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+  Rng rng(seed, Stream::REPLAY);
 
-    // Sleep for better visualization
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  auto start = std::chrono::steady_clock::now();
+  for (int pass = 0; pass < passes; ++pass) {
+    // Fisher-Yates shuffle, so minibatches mix transitions from all episodes
+    for (size_t i = order.size(); i > 1; --i) {
+      std::swap(order[i - 1], order[rng.below(i)]);
+    }
+    for (size_t first = 0; first < log.size(); first += batchSize) {
+      size_t count = std::min(batchSize, log.size() - first);
+      for (size_t i = 0; i < count; ++i) {
+        const TransitionRecord &record = log[order[first + i]];
+        std::copy_n(record.state, GAME_STATE_SIZE,
+                    &batch.states[i * GAME_STATE_SIZE]);
+        std::copy_n(record.nextState, GAME_STATE_SIZE,
+                    &batch.nextStates[i * GAME_STATE_SIZE]);
+        batch.actions[i] = record.action;
+        batch.rewards[i] = record.reward;
+        batch.dones[i] = record.done;
+      }
+      nn.updateQValuesBatch(batch.states.data(), batch.actions.data(),
+                            batch.rewards.data(), batch.nextStates.data(),
+                            batch.dones.data(), count, DISCOUNT_FACTOR,
+                            LEARNING_RATE);
+    }
   }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+
+  size_t trained = log.size() * passes;
+  std::printf("Trained on %zu transitions (%d passes over %zu) in %.2f s, "
+              "%.0f transitions/s\n",
+              trained, passes, log.size(), seconds,
+              seconds > 0.0 ? trained / seconds : 0.0);
+  nn.saveWeights(WEIGHTS_FILE);
+  std::cout << "Weights saved to " << WEIGHTS_FILE << std::endl;
+}
 
-  // Game over message will be shown by the game
+// Reads the value of a numeric command line option. Anything but a plain
+// number in [minimum, maximum] is reported and returns false, and main then
+// exits with status 1.
+template <typename T>
+bool parseNumber(const std::string &option, const std::string &text, T &value,
+                 T minimum = 1, T maximum = std::numeric_limits<T>::max()) {
+  bool valid = !text.empty() &&
+               text.find_first_not_of("0123456789") == std::string::npos;
+  unsigned long long number = 0;
+  if (valid) {
+    errno = 0;
+    number = std::strtoull(text.c_str(), nullptr, 10);
+    valid = errno != ERANGE && number >= (unsigned long long)minimum &&
+            number <= (unsigned long long)maximum;
+  }
+  if (!valid) {
+    std::cerr << "Invalid value for " << option << ": " << text
+              << " (expected " << minimum << " to " << maximum << ")"
+              << std::endl;
+    return false;
+  }
+  value = static_cast<T>(number);
+  return true;
 }
 
 int main(int argc, char *argv[]) {
-  // Seed random number generator
-  srand(time(nullptr));
-
   // Command line arguments
   if (argc > 1) {
     std::string arg = argv[1];
 
     if (arg == "--train" || arg == "-t") {
-      int episodes = 1000;
-      if (argc > 2) {
-        episodes = std::stoi(argv[2]);
+      TrainOptions options;
+      for (int i = 2; i < argc; ++i) {
+        std::string opt = argv[i];
+        if (opt == "--envs" && i + 1 < argc) {
+          if (!parseNumber(opt, argv[++i], options.envCount)) {
+            return 1;
+          }
+        } else if (opt == "--threads" && i + 1 < argc) {
+          if (!parseNumber(opt, argv[++i], options.threads)) {
+            return 1;
+          }
+        } else if (opt == "--replay" && i + 1 < argc) {
+          if (!parseNumber(opt, argv[++i], options.replayCapacity, size_t(1),
+                           MAX_REPLAY_CAPACITY)) {
+            return 1;
+          }
+        } else if (opt == "--prioritized") {
+          options.prioritized = true;
+        } else if (opt == "--target" && i + 1 < argc) {
+          if (!parseNumber(opt, argv[++i], options.targetSync)) {
+            return 1;
+          }
+        } else if (opt == "--double-dqn") {
+          options.doubleDQN = true;
+        } else if (opt == "--resume") {
+          options.resume = true;
+        } else if (opt == "--checkpoints" && i + 1 < argc) {
+          if (!parseNumber(opt, argv[++i], options.keepCheckpoints)) {
+            return 1;
+          }
+        } else if (opt == "--seed" && i + 1 < argc) {
+          if (!parseNumber(opt, argv[++i], options.seed, uint64_t(0))) {
+            return 1;
+          }
+        } else if (opt == "--record" && i + 1 < argc) {
+          options.recordFile = argv[++i];
+        } else if (!opt.empty() && opt.find_first_not_of("0123456789") ==
+                                       std::string::npos) {
+          // The episode count, given as a bare number
+          if (!parseNumber("the episode count", opt, options.episodes)) {
+            return 1;
+          }
+        } else {
+          std::cerr << "Unknown option: " << opt << std::endl;
+          return 1;
+        }
+      }
+      std::cout << "Training AI for " << options.episodes
+                << " episodes (seed " << options.seed << ")..." << std::endl;
+      if (options.threads > 1) {
+        trainAIParallel(options);
+      } else if (options.envCount > 1) {
+        trainAIVectorized(options);
+      } else {
+        trainAI(options);
       }
-      std::cout << "Training AI for " << episodes << " episodes..."
-                << std::endl;
-      trainAI(episodes);
       return 0;
     } else if (arg == "--ai" || arg == "-a") {
-      aiPlay();
+      std::string precision = "double";
+      std::string recordFile;
+      LoopOptions loop;
+      for (int i = 2; i < argc; ++i) {
+        std::string opt = argv[i];
+        if (opt == "--precision" && i + 1 < argc) {
+          precision = argv[++i];
+        } else if (opt == "--tick-rate" && i + 1 < argc) {
+          loop.tickRate = std::stod(argv[++i]);
+        } else if (opt == "--fps" && i + 1 < argc) {
+          loop.maxFps = std::stod(argv[++i]);
+        } else if (opt == "--fast-forward" && i + 1 < argc) {
+          loop.fastForward = std::stoi(argv[++i]);
+        } else if (opt == "--record" && i + 1 < argc) {
+          recordFile = argv[++i];
+        } else {
+          std::cerr << "Unknown option: " << opt << std::endl;
+          return 1;
+        }
+      }
+      if (loop.tickRate <= 0.0 || loop.maxFps <= 0.0) {
+        std::cerr << "Tick rate and fps must be positive" << std::endl;
+        return 1;
+      }
+      aiPlay(precision, loop, recordFile);
+      SnakeRenderer::cleanupNcurses();
+      return 0;
+    } else if (arg == "--learn" && argc > 2) {
+      // Offline training from a log written with --record
+      int passes = 1;
+      uint64_t seed = randomSeed();
+      int targetSync = 0;
+      for (int i = 3; i < argc; ++i) {
+        std::string opt = argv[i];
+        if (opt == "--passes" && i + 1 < argc) {
+          if (!parseNumber(opt, argv[++i], passes)) {
+            return 1;
+          }
+        } else if (opt == "--seed" && i + 1 < argc) {
+          if (!parseNumber(opt, argv[++i], seed, uint64_t(0))) {
+            return 1;
+          }
+        } else if (opt == "--target" && i + 1 < argc) {
+          if (!parseNumber(opt, argv[++i], targetSync)) {
+            return 1;
+          }
+        } else {
+          std::cerr << "Unknown option: " << opt << std::endl;
+          return 1;
+        }
+      }
+      trainFromLog(argv[2], passes, seed, targetSync);
+      return 0;
+    } else if (arg == "--eval" && argc > 2) {
+      // Headless greedy games on every core, e.g. before promoting weights
+      EvalOptions options;
+      if (!parseNumber("the game count", argv[2], options.games)) {
+        return 1;
+      }
+      std::string weights = WEIGHTS_FILE;
+      for (int i = 3; i < argc; ++i) {
+        std::string opt = argv[i];
+        if (opt == "--seed" && i + 1 < argc) {
+          if (!parseNumber(opt, argv[++i], options.seed, uint64_t(0))) {
+            return 1;
+          }
+        } else if (opt == "--threads" && i + 1 < argc) {
+          if (!parseNumber(opt, argv[++i], options.threads, 0)) {
+            return 1;
+          }
+        } else if (opt == "--weights" && i + 1 < argc) {
+          weights = argv[++i];
+        } else {
+          std::cerr << "Unknown option: " << opt << std::endl;
+          return 1;
+        }
+      }
+
+      SnakeNetwork policy;
+      if (!policy.loadWeights(weights)) {
+        std::cerr << "Could not load weights from " << weights << std::endl;
+        return 1;
+      }
+      printEvalStats(evaluatePolicy(policy, options));
+      return 0;
+    } else if (arg == "--convert-weights" && argc > 3) {
+      // Rewrite a weight file from before the format was versioned
+      if (!WeightsFile::convertLegacy(argv[2], argv[3])) {
+        return 1;
+      }
+      std::cout << "Converted " << argv[2] << " to " << argv[3] << std::endl;
       return 0;
     }
   }
@@ -267,25 +708,28 @@ int main(int argc, char *argv[]) {
   case 1: {
     // Manual play
     SnakeGame game(20, 40);
-    game.run(false);
+    SnakeRenderer renderer(game);
+    renderer.run();
+    renderer.showGameOver();
     break;
   }
   case 2: {
     // Train AI
     std::cout << "How many episodes? ";
-    int episodes;
-    std::cin >> episodes;
-    trainAI(episodes);
+    TrainOptions options;
+    std::cin >> options.episodes;
+    trainAI(options);
     break;
   }
   case 3:
     // AI play
-    aiPlay();
+    aiPlay("double");
     break;
   default:
     std::cout << "Invalid choice." << std::endl;
     break;
   }
 
+  SnakeRenderer::cleanupNcurses();
   return 0;
 }
@@ -1,237 +1,536 @@
 #include "nn.h"
+#include "kernels.h"
+#include "profiling.h"
+#include "rng.h"
+#include "weights_file.h"
 
 #include <algorithm>
 #include <cmath>
-#include <fstream>
 #include <iostream>
-#include <random>
 
 NeuralNetwork::NeuralNetwork(const std::vector<int> &topology)
+    : NeuralNetwork(topology, randomSeed()) {}
+
+NeuralNetwork::NeuralNetwork(const std::vector<int> &topology, uint64_t seed)
     : topology(topology) {
-  // Initialize random number generator
-  std::random_device rd;
-  std::mt19937 rng(rd());
-  std::uniform_real_distribution<double> dist(-1.0, 1.0);
+  Rng rng(seed);
 
-  // Initialize layers
-  neurons.resize(topology.size());
-  deltas.resize(topology.size());
+  // Compute padded row lengths and buffer offsets
+  size_t layerCount = topology.size();
+  stride.resize(layerCount);
+  neuronOffset.resize(layerCount);
+  weightOffset.resize(layerCount - 1);
+  biasOffset.resize(layerCount - 1);
+
+  size_t neuronCount = 0;
+  for (size_t i = 0; i < layerCount; ++i) {
+    stride[i] = padToLine(topology[i]);
+    neuronOffset[i] = neuronCount;
+    neuronCount += stride[i];
+  }
 
-  for (size_t i = 0; i < topology.size(); ++i) {
-    neurons[i].resize(topology[i], 0.0);
-    deltas[i].resize(topology[i], 0.0);
+  size_t weightCount = 0, biasCount = 0;
+  for (size_t layer = 0; layer + 1 < layerCount; ++layer) {
+    weightOffset[layer] = weightCount;
+    weightCount += topology[layer + 1] * stride[layer];
+    biasOffset[layer] = biasCount;
+    biasCount += stride[layer + 1];
   }
 
+  // Batch scratch, sized for the widest layer
+  size_t packedCount = 0, maxStride = 0;
+  packedOffset.resize(layerCount - 1);
+  for (size_t layer = 0; layer + 1 < layerCount; ++layer) {
+    packedOffset[layer] = packedCount;
+    packedCount += topology[layer] * stride[layer + 1];
+  }
+  for (size_t i = 0; i < layerCount; ++i) {
+    maxStride = std::max(maxStride, stride[i]);
+  }
+  packedWeights.assign(packedCount, 0.0);
+  batchActs[0].assign(BATCH_BLOCK * maxStride, 0.0);
+  batchActs[1].assign(BATCH_BLOCK * maxStride, 0.0);
+  trainActs.resize(layerCount);
+  trainDeltas.resize(layerCount);
+  zeroBias.assign(maxStride, 0.0);
+  qTargets.assign(topology.back(), 0.0);
+
+  // Initialize layers
+  gradWeights.assign(weightCount, 0.0);
+  neurons.assign(neuronCount, 0.0);
+  deltas.assign(neuronCount, 0.0);
+
   // Initialize weights and biases
-  weights.resize(topology.size() - 1);
-  biases.resize(topology.size() - 1);
+  weights.assign(weightCount, 0.0);
+  biases.assign(biasCount, 0.0);
 
-  for (size_t layer = 0; layer < weights.size(); ++layer) {
-    weights[layer].resize(topology[layer + 1]);
-    biases[layer].resize(topology[layer + 1]);
+  for (size_t layer = 0; layer + 1 < layerCount; ++layer) {
+    double *w = layerWeights(layer);
+    double *b = layerBiases(layer);
 
-    for (size_t neuron = 0; neuron < topology[layer + 1]; ++neuron) {
-      weights[layer][neuron].resize(topology[layer]);
+    for (int neuron = 0; neuron < topology[layer + 1]; ++neuron) {
+      double *row = w + neuron * stride[layer];
 
       // Initialize random weights
-      for (size_t w = 0; w < weights[layer][neuron].size(); ++w) {
-        weights[layer][neuron][w] = dist(rng);
+      for (int input = 0; input < topology[layer]; ++input) {
+        row[input] = 2.0 * rng.uniform() - 1.0;
       }
 
       // Initialize random bias
-      biases[layer][neuron] = dist(rng);
+      b[neuron] = 2.0 * rng.uniform() - 1.0;
     }
   }
 }
 
 std::vector<double>
 NeuralNetwork::feedForward(const std::vector<double> &inputs) {
+  const double *output = feedForward(inputs.data());
+  return std::vector<double>(output, output + topology.back());
+}
+
+const double *NeuralNetwork::feedForward(const double *inputs) {
+  PROFILE_SCOPE(FEED_FORWARD);
+
+  forwardPass(inputs, weights.data(), biases.data());
+
+  double *output = layerNeurons(topology.size() - 1);
+  kernels().sigmoid(topology.back(), output);
+  return output;
+}
+
+void NeuralNetwork::forwardPass(const double *inputs, const double *w,
+                                const double *b) {
   // Set input layer
-  for (size_t i = 0; i < inputs.size(); ++i) {
-    neurons[0][i] = inputs[i];
+  std::copy_n(inputs, topology[0], layerNeurons(0));
+
+  // Forward propagation. Padding is zero in both operands, so each dot
+  // product runs over the whole padded row. The output layer is left as
+  // weighted sums for the caller to activate.
+  const Kernels &k = kernels();
+  size_t outputLayer = topology.size() - 1;
+  for (size_t layer = 0; layer < outputLayer; ++layer) {
+    double *out = layerNeurons(layer + 1);
+    k.matVec(w + weightOffset[layer], stride[layer], topology[layer + 1],
+             layerNeurons(layer), b + biasOffset[layer], out);
+    if (layer + 1 < outputLayer) {
+      k.sigmoid(topology[layer + 1], out);
+    }
+  }
+}
+
+void NeuralNetwork::packWeights(const double *w, double *packed) {
+  // Transpose each layer so the GEMM streams one contiguous row of output
+  // neurons per input; padding columns stay zero
+  for (size_t layer = 0; layer + 1 < topology.size(); ++layer) {
+    const double *lw = w + weightOffset[layer];
+    double *lp = packed + packedOffset[layer];
+    size_t outStride = stride[layer + 1];
+    for (int neuron = 0; neuron < topology[layer + 1]; ++neuron) {
+      for (int input = 0; input < topology[layer]; ++input) {
+        lp[input * outStride + neuron] = lw[neuron * stride[layer] + input];
+      }
+    }
   }
+}
 
-  // Forward propagation
-  for (size_t layer = 0; layer < weights.size(); ++layer) {
-    for (size_t neuron = 0; neuron < topology[layer + 1]; ++neuron) {
-      double sum = biases[layer][neuron];
+void NeuralNetwork::feedForwardBatch(const double *inputs, size_t count,
+                                     double *outputs) {
+  packWeights(weights.data(), packedWeights.data());
+  forwardBatch(inputs, count, outputs, packedWeights.data(), biases.data());
+}
 
-      for (size_t input = 0; input < topology[layer]; ++input) {
-        sum += neurons[layer][input] * weights[layer][neuron][input];
+void NeuralNetwork::forwardBatch(const double *inputs, size_t count,
+                                 double *outputs, const double *packed,
+                                 const double *b) {
+  const Kernels &k = kernels();
+  size_t lastLayer = topology.size() - 1;
+  size_t outputCount = topology.back();
+
+  // Run BATCH_BLOCK rows through all layers at a time so the activations
+  // stay in cache between layers
+  for (size_t start = 0; start < count; start += BATCH_BLOCK) {
+    size_t rows = std::min(BATCH_BLOCK, count - start);
+    const double *a = inputs + start * topology[0];
+    size_t lda = topology[0];
+
+    for (size_t layer = 0; layer < lastLayer; ++layer) {
+      double *c = batchActs[layer % 2].data();
+      size_t ldc = stride[layer + 1];
+      k.gemm(a, lda, rows, topology[layer], packed + packedOffset[layer], ldc,
+             b + biasOffset[layer], c, ldc);
+      for (size_t r = 0; r < rows; ++r) {
+        k.sigmoid(topology[layer + 1], c + r * ldc);
       }
+      a = c;
+      lda = ldc;
+    }
 
-      neurons[layer + 1][neuron] = sigmoid(sum);
+    // Copy the unpadded output rows to the caller
+    for (size_t r = 0; r < rows; ++r) {
+      std::copy(a + r * lda, a + r * lda + outputCount,
+                outputs + (start + r) * outputCount);
     }
   }
-
-  // Return output layer
-  return neurons.back();
 }
 
 void NeuralNetwork::backPropagate(const std::vector<double> &targets,
-                                  double learningRate) {
+                                  double learningRate, double weight) {
+  backPropagate(targets.data(), learningRate, weight);
+}
+
+void NeuralNetwork::backPropagate(const double *targets, double learningRate,
+                                  double weight) {
+  PROFILE_SCOPE(BACK_PROPAGATE);
+
+  const Kernels &k = kernels();
+  size_t outputLayer = topology.size() - 1;
+
   // Calculate output layer deltas
-  for (size_t i = 0; i < neurons.back().size(); ++i) {
-    double output = neurons.back()[i];
-    deltas.back()[i] = (targets[i] - output) * sigmoidDerivative(output);
+  const double *output = layerNeurons(outputLayer);
+  double *outputDeltas = layerDeltas(outputLayer);
+  for (int i = 0; i < topology[outputLayer]; ++i) {
+    outputDeltas[i] =
+        weight * (targets[i] - output[i]) * sigmoidDerivative(output[i]);
   }
 
-  // Calculate hidden layer deltas
-  for (int layer = topology.size() - 2; layer > 0; --layer) {
-    for (size_t neuron = 0; neuron < topology[layer]; ++neuron) {
-      double error = 0.0;
-
-      for (size_t nextNeuron = 0; nextNeuron < topology[layer + 1];
-           ++nextNeuron) {
-        error +=
-            weights[layer][nextNeuron][neuron] * deltas[layer + 1][nextNeuron];
-      }
+  // Calculate hidden layer deltas: error = W^T * nextDeltas, accumulated one
+  // weight row at a time so the inner loop walks memory contiguously
+  for (size_t layer = outputLayer - 1; layer > 0; --layer) {
+    const double *w = layerWeights(layer);
+    const double *nextDeltas = layerDeltas(layer + 1);
+    const double *act = layerNeurons(layer);
+    double *d = layerDeltas(layer);
+    size_t inStride = stride[layer];
+
+    std::fill(d, d + inStride, 0.0);
+    for (int next = 0; next < topology[layer + 1]; ++next) {
+      k.axpy(inStride, nextDeltas[next], w + next * inStride, d);
+    }
 
-      lastError = error;
-      deltas[layer][neuron] = error * sigmoidDerivative(neurons[layer][neuron]);
+    for (int neuron = 0; neuron < topology[layer]; ++neuron) {
+      d[neuron] *= sigmoidDerivative(act[neuron]);
     }
   }
 
   // Update weights and biases
-  for (size_t layer = 0; layer < weights.size(); ++layer) {
-    for (size_t neuron = 0; neuron < topology[layer + 1]; ++neuron) {
-      for (size_t input = 0; input < topology[layer]; ++input) {
-        weights[layer][neuron][input] +=
-            learningRate * deltas[layer + 1][neuron] * neurons[layer][input];
-      }
-
-      biases[layer][neuron] += learningRate * deltas[layer + 1][neuron];
+  for (size_t layer = 0; layer < outputLayer; ++layer) {
+    const double *in = layerNeurons(layer);
+    const double *d = layerDeltas(layer + 1);
+    double *w = layerWeights(layer);
+    double *b = layerBiases(layer);
+    size_t inStride = stride[layer];
+
+    for (int neuron = 0; neuron < topology[layer + 1]; ++neuron) {
+      double scale = learningRate * d[neuron];
+      k.axpy(inStride, scale, in, w + neuron * inStride);
+      b[neuron] += scale;
     }
   }
 }
 
 int NeuralNetwork::getAction(const std::vector<double> &gameState) {
+  return getAction(gameState.data());
+}
+
+int NeuralNetwork::getAction(const double *gameState) {
+  PROFILE_SCOPE(ACTION);
+
   // Feed the game state through the network
-  std::vector<double> outputs = feedForward(gameState);
+  forwardPass(gameState, weights.data(), biases.data());
 
   // Find the action with the highest Q-value
-  return std::distance(outputs.begin(),
-                       std::max_element(outputs.begin(), outputs.end()));
+  const double *output = layerNeurons(topology.size() - 1);
+  return std::max_element(output, output + topology.back()) - output;
+}
+
+void NeuralNetwork::getActionBatch(const double *gameStates, size_t count,
+                                   int *actions) {
+  PROFILE_SCOPE(ACTION);
+
+  size_t outputCount = topology.back();
+  batchOutputs.resize(count * outputCount);
+  feedForwardBatch(gameStates, count, batchOutputs.data());
+
+  for (size_t i = 0; i < count; ++i) {
+    const double *row = &batchOutputs[i * outputCount];
+    actions[i] = std::max_element(row, row + outputCount) - row;
+  }
 }
 
 void NeuralNetwork::updateQValues(const std::vector<double> &state, int action,
                                   double reward,
                                   const std::vector<double> &newState,
-                                  double discount, double learningRate) {
-  // Current Q-values
-  std::vector<double> currentQValues = feedForward(state);
+                                  bool done, double discount,
+                                  double learningRate) {
+  updateQValues(state.data(), action, reward, newState.data(), done, discount,
+                learningRate);
+}
+
+void NeuralNetwork::updateQValues(const double *state, int action,
+                                  double reward, const double *newState,
+                                  bool done, double discount,
+                                  double learningRate) {
+  PROFILE_SCOPE(Q_UPDATE);
+
+  // Value of the next state. This runs first so that the activations left
+  // for backPropagate() are the ones from state.
+  double nextQ = done ? 0.0 : nextStateValue(newState);
 
-  // Get max Q-value for the next state
-  std::vector<double> nextQValues = feedForward(newState);
-  double maxNextQ = *std::max_element(nextQValues.begin(), nextQValues.end());
+  // Current Q-values
+  const double *currentQValues = feedForward(state);
+  std::copy_n(currentQValues, topology.back(), qTargets.data());
 
   // Update the Q-value for the taken action using Q-learning formula
   // Q(s,a) = Q(s,a) + alpha * (reward + gamma * max(Q(s',a')) - Q(s,a))
-  currentQValues[action] =
-      currentQValues[action] +
-      learningRate * (reward + discount * maxNextQ - currentQValues[action]);
+  lastError = reward + discount * nextQ - qTargets[action];
+  qTargets[action] = qTargets[action] + learningRate * lastError;
 
   // Backpropagate to train the network
-  backPropagate(currentQValues, learningRate);
+  backPropagate(qTargets.data(), learningRate);
+  countUpdate();
 }
 
-double NeuralNetwork::sigmoid(double x) const { return 1.0 / (1.0 + exp(-x)); }
+double NeuralNetwork::nextStateValue(const double *newState) {
+  size_t outputCount = topology.back();
+  if (targetSyncInterval == 0) {
+    const double *q = feedForward(newState);
+    return *std::max_element(q, q + outputCount);
+  }
 
-double NeuralNetwork::sigmoidDerivative(double x) const {
-  return x * (1.0 - x);
+  // Double DQN: the online network chooses, the target network evaluates
+  int best = doubleDQN ? getAction(newState) : -1;
+
+  forwardPass(newState, targetWeights.data(), targetBiases.data());
+  double *q = layerNeurons(topology.size() - 1);
+  kernels().sigmoid(outputCount, q);
+  return best >= 0 ? q[best] : *std::max_element(q, q + outputCount);
 }
 
-double NeuralNetwork::getTotalError(const std::vector<double> &targets) const {
-  double sum = 0.0;
+void NeuralNetwork::nextStateValues(const double *nextStates, size_t count) {
+  size_t outputCount = topology.back();
+  batchMaxNextQ.resize(count);
+  batchOutputs.resize(count * outputCount);
+
+  if (targetSyncInterval == 0) {
+    feedForwardBatch(nextStates, count, batchOutputs.data());
+  } else {
+    if (doubleDQN) {
+      batchNextActions.resize(count);
+      getActionBatch(nextStates, count, batchNextActions.data());
+    }
+    forwardBatch(nextStates, count, batchOutputs.data(), targetPacked.data(),
+                 targetBiases.data());
+  }
 
-  for (size_t i = 0; i < targets.size(); ++i) {
-    double diff = targets[i] - neurons.back()[i];
-    sum += diff * diff;
+  for (size_t i = 0; i < count; ++i) {
+    const double *row = &batchOutputs[i * outputCount];
+    batchMaxNextQ[i] = targetSyncInterval > 0 && doubleDQN
+                           ? row[batchNextActions[i]]
+                           : *std::max_element(row, row + outputCount);
   }
+}
 
-  return sum / targets.size();
+void NeuralNetwork::enableTargetNetwork(int syncInterval, bool doubleDQN) {
+  targetSyncInterval = syncInterval;
+  this->doubleDQN = doubleDQN;
+  targetPacked.assign(packedWeights.size(), 0.0);
+  syncTargetNetwork();
 }
 
-void NeuralNetwork::saveWeights(const std::string &filename) const {
-  std::ofstream file(filename, std::ios::binary);
+void NeuralNetwork::syncTargetNetwork() {
+  targetWeights = weights;
+  targetBiases = biases;
+  packWeights(targetWeights.data(), targetPacked.data());
+  updatesSinceSync = 0;
+}
 
-  if (!file) {
-    std::cerr << "Error opening file for writing: " << filename << std::endl;
-    return;
-  }
+void NeuralNetwork::setParameters(const double *w, const double *b) {
+  std::copy_n(w, weights.size(), weights.data());
+  std::copy_n(b, biases.size(), biases.data());
+}
 
-  // Save topology
-  size_t layerCount = topology.size();
-  file.write(reinterpret_cast<const char *>(&layerCount), sizeof(layerCount));
+void NeuralNetwork::restoreTargetNetwork(const double *w, const double *b,
+                                         int updatesSinceSync) {
+  std::copy_n(w, targetWeights.size(), targetWeights.data());
+  std::copy_n(b, targetBiases.size(), targetBiases.data());
+  packWeights(targetWeights.data(), targetPacked.data());
+  this->updatesSinceSync = updatesSinceSync;
+}
 
-  for (size_t i = 0; i < layerCount; ++i) {
-    file.write(reinterpret_cast<const char *>(&topology[i]),
-               sizeof(topology[i]));
+void NeuralNetwork::countUpdate() {
+  if (targetSyncInterval > 0 && ++updatesSinceSync >= targetSyncInterval) {
+    syncTargetNetwork();
+  }
+}
+
+void NeuralNetwork::updateQValuesBatch(const double *states,
+                                       const int *actions,
+                                       const double *rewards,
+                                       const double *nextStates,
+                                       const uint8_t *dones, size_t count,
+                                       double discount, double learningRate,
+                                       const double *weights,
+                                       double *tdErrors) {
+  PROFILE_SCOPE(Q_UPDATE);
+
+  const Kernels &k = kernels();
+  size_t outputLayer = topology.size() - 1;
+
+  // Value of every next state
+  nextStateValues(nextStates, count);
+
+  // Forward pass over the batch, keeping every layer's activations. Padding
+  // columns are zero: new elements are zero-filled and the GEMM writes bias
+  // padding (zero) into them.
+  for (size_t layer = 0; layer <= outputLayer; ++layer) {
+    trainActs[layer].resize(count * stride[layer]);
+    trainDeltas[layer].resize(count * stride[layer]);
+  }
+  for (size_t i = 0; i < count; ++i) {
+    std::copy_n(states + i * topology[0], topology[0],
+                &trainActs[0][i * stride[0]]);
+  }
+  packWeights(this->weights.data(), packedWeights.data());
+  for (size_t layer = 0; layer < outputLayer; ++layer) {
+    double *c = trainActs[layer + 1].data();
+    size_t ldc = stride[layer + 1];
+    k.gemm(trainActs[layer].data(), stride[layer], count, topology[layer],
+           &packedWeights[packedOffset[layer]], ldc, layerBiases(layer), c,
+           ldc);
+    for (size_t i = 0; i < count; ++i) {
+      k.sigmoid(topology[layer + 1], c + i * ldc);
+    }
   }
 
-  // Save weights
-  for (size_t layer = 0; layer < weights.size(); ++layer) {
-    for (size_t neuron = 0; neuron < weights[layer].size(); ++neuron) {
-      for (size_t w = 0; w < weights[layer][neuron].size(); ++w) {
-        file.write(reinterpret_cast<const char *>(&weights[layer][neuron][w]),
-                   sizeof(double));
+  // Output deltas: only the taken action has a target different from the
+  // current estimate, using the same target as updateQValues()
+  double tdErrorSum = 0.0;
+  AlignedVector &outDeltas = trainDeltas[outputLayer];
+  std::fill(outDeltas.begin(), outDeltas.end(), 0.0);
+  for (size_t i = 0; i < count; ++i) {
+    double q = trainActs[outputLayer][i * stride[outputLayer] + actions[i]];
+    double bootstrap = dones[i] ? 0.0 : discount * batchMaxNextQ[i];
+    double tdError = rewards[i] + bootstrap - q;
+    double target = q + learningRate * tdError;
+    double weight = weights ? weights[i] : 1.0;
+    outDeltas[i * stride[outputLayer] + actions[i]] =
+        weight * (target - q) * sigmoidDerivative(q);
+    tdErrorSum += tdError;
+    if (tdErrors) {
+      tdErrors[i] = tdError;
+    }
+  }
+  lastError = tdErrorSum / count;
+
+  // Hidden deltas for the whole batch: D[layer] = D[layer + 1] * W, which is
+  // a GEMM against the weights in their native layout
+  for (size_t layer = outputLayer - 1; layer > 0; --layer) {
+    double *d = trainDeltas[layer].data();
+    const double *act = trainActs[layer].data();
+    k.gemm(trainDeltas[layer + 1].data(), stride[layer + 1], count,
+           topology[layer + 1], layerWeights(layer), stride[layer],
+           zeroBias.data(), d, stride[layer]);
+    for (size_t i = 0; i < count; ++i) {
+      for (int neuron = 0; neuron < topology[layer]; ++neuron) {
+        size_t idx = i * stride[layer] + neuron;
+        d[idx] *= sigmoidDerivative(act[idx]);
       }
     }
   }
 
-  // Save biases
-  for (size_t layer = 0; layer < biases.size(); ++layer) {
-    for (size_t neuron = 0; neuron < biases[layer].size(); ++neuron) {
-      file.write(reinterpret_cast<const char *>(&biases[layer][neuron]),
-                 sizeof(double));
+  // Gradient of each layer is D[layer + 1]^T * A[layer]; apply the batch
+  // mean in one step
+  double scale = learningRate / count;
+  for (size_t layer = 0; layer < outputLayer; ++layer) {
+    size_t outputs = topology[layer + 1];
+    const double *d = trainDeltas[layer + 1].data();
+    size_t dStride = stride[layer + 1];
+
+    transposedDeltas.resize(outputs * count);
+    for (size_t i = 0; i < count; ++i) {
+      for (size_t o = 0; o < outputs; ++o) {
+        transposedDeltas[o * count + i] = d[i * dStride + o];
+      }
+    }
+
+    double *grad = &gradWeights[weightOffset[layer]];
+    k.gemm(transposedDeltas.data(), count, outputs, count,
+           trainActs[layer].data(), stride[layer], zeroBias.data(), grad,
+           stride[layer]);
+    k.axpy(outputs * stride[layer], scale, grad, layerWeights(layer));
+
+    double *b = layerBiases(layer);
+    for (size_t o = 0; o < outputs; ++o) {
+      const double *column = &transposedDeltas[o * count];
+      double sum = 0.0;
+      for (size_t i = 0; i < count; ++i) {
+        sum += column[i];
+      }
+      b[o] += scale * sum;
     }
   }
 
-  file.close();
+  countUpdate();
 }
 
-bool NeuralNetwork::loadWeights(const std::string &filename) {
-  std::ifstream file(filename, std::ios::binary);
+double NeuralNetwork::sigmoidDerivative(double x) const {
+  return x * (1.0 - x);
+}
 
-  if (!file) {
-    std::cerr << "Error opening file for reading: " << filename << std::endl;
-    return false;
+double NeuralNetwork::getTotalError(const std::vector<double> &targets) const {
+  double sum = 0.0;
+  const double *output = layerNeurons(topology.size() - 1);
+
+  for (size_t i = 0; i < targets.size(); ++i) {
+    double diff = targets[i] - output[i];
+    sum += diff * diff;
   }
 
-  // Read topology
-  size_t layerCount;
-  file.read(reinterpret_cast<char *>(&layerCount), sizeof(layerCount));
+  return sum / targets.size();
+}
 
-  std::vector<int> loadedTopology(layerCount);
-  for (size_t i = 0; i < layerCount; ++i) {
-    file.read(reinterpret_cast<char *>(&loadedTopology[i]),
-              sizeof(loadedTopology[i]));
-  }
+void NeuralNetwork::saveWeights(const std::string &filename) const {
+  // The file holds the padded, cache line aligned buffers as they are
+  WeightsFile::save(filename, topology, weights.data(), weights.size(),
+                    biases.data(), biases.size());
+}
 
-  // Check if topology matches
-  if (loadedTopology != topology) {
-    std::cerr << "Topology mismatch. Cannot load weights." << std::endl;
-    return false;
-  }
+bool NeuralNetwork::loadWeights(const std::string &filename) {
+  // Files written before the format was versioned are still accepted
+  if (WeightsFile::isLegacy(filename)) {
+    std::vector<int> loadedTopology;
+    AlignedVector loadedWeights, loadedBiases;
+    if (!WeightsFile::readLegacy(filename, loadedTopology, loadedWeights,
+                                 loadedBiases)) {
+      return false;
+    }
+    if (loadedTopology != topology) {
+      std::cerr << "Topology mismatch. Cannot load weights." << std::endl;
+      return false;
+    }
+    weights = loadedWeights;
+    biases = loadedBiases;
 
-  // Read weights
-  for (size_t layer = 0; layer < weights.size(); ++layer) {
-    for (size_t neuron = 0; neuron < weights[layer].size(); ++neuron) {
-      for (size_t w = 0; w < weights[layer][neuron].size(); ++w) {
-        file.read(reinterpret_cast<char *>(&weights[layer][neuron][w]),
-                  sizeof(double));
-      }
+    if (targetSyncInterval > 0) {
+      syncTargetNetwork();
     }
+    return true;
   }
 
-  // Read biases
-  for (size_t layer = 0; layer < biases.size(); ++layer) {
-    for (size_t neuron = 0; neuron < biases[layer].size(); ++neuron) {
-      file.read(reinterpret_cast<char *>(&biases[layer][neuron]),
-                sizeof(double));
-    }
+  WeightsFile file;
+  return file.open(filename) && loadWeights(file);
+}
+
+bool NeuralNetwork::loadWeights(const WeightsFile &file) {
+  if (file.getTopology() != topology) {
+    std::cerr << "Topology mismatch. Cannot load weights." << std::endl;
+    return false;
   }
+  std::copy_n(file.weightData(), file.weightCount(), weights.data());
+  std::copy_n(file.biasData(), file.biasCount(), biases.data());
 
-  file.close();
+  if (targetSyncInterval > 0) {
+    syncTargetNetwork();
+  }
   return true;
 }
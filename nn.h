@@ -1,59 +1,198 @@
 #ifndef NN_H
 #define NN_H
 
-#include <random>
+#include "aligned.h"
+#include <cstdint>
+#include <string>
 #include <vector>
 
+class WeightsFile;
+
 class NeuralNetwork {
 public:
-  // Constructor
+  // Constructors. Initial weights are drawn from the random stream keyed by
+  // seed (see Rng::streamKey()), or a randomly seeded one.
   NeuralNetwork(const std::vector<int> &topology);
+  NeuralNetwork(const std::vector<int> &topology, uint64_t seed);
 
   // Forward propagation
   std::vector<double> feedForward(const std::vector<double> &inputs);
 
-  // Backpropagation training
-  void backPropagate(const std::vector<double> &targets, double learningRate);
-
-  // Get the predicted action
+  // Forward propagation without allocating. Returns the output layer, which
+  // stays valid until the network is next run or trained.
+  const double *feedForward(const double *inputs);
+
+  // Batched forward propagation. inputs holds count rows of topology.front()
+  // values and outputs receives count rows of topology.back() values; both
+  // are row-major and owned by the caller. Does not change the activations
+  // used by backPropagate().
+  void feedForwardBatch(const double *inputs, size_t count, double *outputs);
+
+  // Backpropagation training. weight scales the step, e.g. an
+  // importance-sampling weight from prioritized replay.
+  void backPropagate(const std::vector<double> &targets, double learningRate,
+                     double weight = 1.0);
+  void backPropagate(const double *targets, double learningRate,
+                     double weight = 1.0);
+
+  // Get the predicted action. The pointer overload skips the output sigmoid
+  // (it is monotonic, so the argmax is unchanged) and leaves the output layer
+  // unactivated.
   int getAction(const std::vector<double> &gameState);
+  int getAction(const double *gameState);
+
+  // Predicted actions for count game states stored row-major
+  void getActionBatch(const double *gameStates, size_t count, int *actions);
 
-  // Q-learning update
+  // Q-learning update. A terminal transition (done) does not bootstrap
+  // from newState.
   void updateQValues(const std::vector<double> &state, int action,
                      double reward, const std::vector<double> &newState,
-                     double discount, double learningRate);
-
-  // Save and load weights
+                     bool done, double discount, double learningRate);
+  void updateQValues(const double *state, int action, double reward,
+                     const double *newState, bool done, double discount,
+                     double learningRate);
+
+  // Q-learning update on a minibatch of count transitions stored row-major,
+  // applied as one gradient step averaged over the batch. Terminal
+  // transitions (dones[i] != 0) do not bootstrap from the next state.
+  // Optional per-sample weights scale each sample's contribution; if
+  // tdErrors is given it receives each sample's TD error.
+  void updateQValuesBatch(const double *states, const int *actions,
+                          const double *rewards, const double *nextStates,
+                          const uint8_t *dones, size_t count, double discount,
+                          double learningRate, const double *weights = nullptr,
+                          double *tdErrors = nullptr);
+
+  // Frozen target network for the Q-learning updates: next-state values come
+  // from a copy of the weights refreshed every syncInterval updates. With
+  // doubleDQN the online network picks the next action and the target
+  // network values it. Enabling takes a copy immediately.
+  void enableTargetNetwork(int syncInterval, bool doubleDQN = false);
+  void syncTargetNetwork();
+
+  // Save and load weights. The WeightsFile overload copies from an already
+  // open (validated) file.
   void saveWeights(const std::string &filename) const;
   bool loadWeights(const std::string &filename);
+  bool loadWeights(const WeightsFile &file);
 
+  // TD error of the last Q-value update, averaged over the batch for
+  // updateQValuesBatch()
   double getError() { return lastError; };
 
+  // Read-only access to the parameters, e.g. to build other inference
+  // engines. Weight rows of a layer are getStride(layer) doubles apart.
+  const std::vector<int> &getTopology() const { return topology; }
+  size_t getStride(size_t layer) const { return stride[layer]; }
+  const double *getWeights(size_t layer) const { return layerWeights(layer); }
+  const double *getBiases(size_t layer) const { return layerBiases(layer); }
+
+  // Checkpoint support: the whole padded parameter buffers, the target
+  // network's (empty while it is disabled) and updates since its last sync
+  const AlignedVector &getWeightBuffer() const { return weights; }
+  const AlignedVector &getBiasBuffer() const { return biases; }
+  const AlignedVector &getTargetWeightBuffer() const { return targetWeights; }
+  const AlignedVector &getTargetBiasBuffer() const { return targetBiases; }
+  int getUpdatesSinceSync() const { return updatesSinceSync; }
+
+  // Replace the weights and biases with buffers laid out like
+  // getWeightBuffer() and getBiasBuffer(), e.g. from another network of the
+  // same topology. Scratch space and the target network are left alone.
+  void setParameters(const double *w, const double *b);
+
+  // Replace the target network with saved buffers laid out like the online
+  // ones. The target network must be enabled.
+  void restoreTargetNetwork(const double *w, const double *b,
+                            int updatesSinceSync);
+
 private:
   // Topology (layers and neurons per layer)
   std::vector<int> topology;
 
-  // Neuron layers
-  std::vector<std::vector<double>> neurons; // [layer][neuron]
-
-  // Weight connections
-  std::vector<std::vector<std::vector<double>>>
-      weights; // [layer][neuron][connection]
-
-  // Biases
-  std::vector<std::vector<double>> biases; // [layer][neuron]
-
-  // Deltas for backpropagation
-  std::vector<std::vector<double>> deltas; // [layer][neuron]
-
-  // Random number generator
-  std::mt19937 rng;
+  // Row length of each layer, padded to a whole cache line. Padding entries
+  // are kept at zero so they never contribute to a dot product.
+  std::vector<size_t> stride;
+
+  // All layers live in single contiguous, cache line aligned buffers. Each
+  // layer starts at its offset, which is a multiple of a cache line.
+
+  // Neuron layers: [neuronOffset[layer] + neuron]
+  AlignedVector neurons;
+  std::vector<size_t> neuronOffset;
+
+  // Deltas for backpropagation, laid out like neurons
+  AlignedVector deltas;
+
+  // Weight connections, row-major per layer:
+  // [weightOffset[layer] + neuron * stride[layer] + connection]
+  AlignedVector weights;
+  std::vector<size_t> weightOffset;
+
+  // Biases: [biasOffset[layer] + neuron]
+  AlignedVector biases;
+  std::vector<size_t> biasOffset;
+
+  // Scratch space for feedForwardBatch(): weights packed transposed per layer
+  // ([packedOffset[layer] + input * stride[layer + 1] + neuron]) and two
+  // activation blocks of BATCH_BLOCK padded rows
+  static constexpr size_t BATCH_BLOCK = 64;
+  AlignedVector packedWeights;
+  std::vector<size_t> packedOffset;
+  AlignedVector batchActs[2];
+  AlignedVector batchOutputs;
+
+  // Scratch space for updateQValuesBatch(): per-layer activations and deltas
+  // of the whole minibatch ([layer][sample * stride[layer] + neuron]), the
+  // gradient laid out like weights, and transposed deltas
+  std::vector<AlignedVector> trainActs;
+  std::vector<AlignedVector> trainDeltas;
+  AlignedVector gradWeights;
+  AlignedVector transposedDeltas;
+  AlignedVector zeroBias;
+  std::vector<double> batchMaxNextQ;
+
+  // Target Q-values built by updateQValues()
+  AlignedVector qTargets;
+
+  // Target network: weights and biases laid out like the online ones, plus
+  // their packed transpose for batched updates. Unused while
+  // targetSyncInterval is 0.
+  AlignedVector targetWeights;
+  AlignedVector targetBiases;
+  AlignedVector targetPacked;
+  int targetSyncInterval = 0;
+  int updatesSinceSync = 0;
+  bool doubleDQN = false;
+  std::vector<int> batchNextActions;
 
   // Last error for getFunction
-  double lastError;
-
-  // Helper methods
-  double sigmoid(double x) const;
+  double lastError = 0.0;
+
+  // Layer accessors into the flat buffers
+  double *layerNeurons(size_t layer) { return &neurons[neuronOffset[layer]]; }
+  const double *layerNeurons(size_t layer) const {
+    return &neurons[neuronOffset[layer]];
+  }
+  double *layerDeltas(size_t layer) { return &deltas[neuronOffset[layer]]; }
+  double *layerWeights(size_t layer) { return &weights[weightOffset[layer]]; }
+  const double *layerWeights(size_t layer) const {
+    return &weights[weightOffset[layer]];
+  }
+  double *layerBiases(size_t layer) { return &biases[biasOffset[layer]]; }
+  const double *layerBiases(size_t layer) const {
+    return &biases[biasOffset[layer]];
+  }
+
+  // Helper methods. w and b are whole weight and bias buffers (online or
+  // target); packed is laid out like packedWeights.
+  void forwardPass(const double *inputs, const double *w, const double *b);
+  void forwardBatch(const double *inputs, size_t count, double *outputs,
+                    const double *packed, const double *b);
+  void packWeights(const double *w, double *packed);
+  double nextStateValue(const double *newState);
+  void nextStateValues(const double *nextStates, size_t count);
+  void countUpdate();
   double sigmoidDerivative(double x) const;
   double getTotalError(const std::vector<double> &targets) const;
 };
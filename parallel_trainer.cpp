@@ -0,0 +1,295 @@
+#include "checkpoint.h"
+#include "nn.h"
+#include "profiling.h"
+#include "replay_buffer.h"
+#include "snake.h"
+#include "thread_pool.h"
+#include "training.h"
+#include "transition_log.h"
+#include "transition.h"
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+// Transitions an actor collects before handing them to the learner
+const size_t ACTOR_BATCH_SIZE = 64;
+
+// Batches that may wait for the learner before actors block
+const size_t QUEUE_CAPACITY = 256;
+
+// Episodes in flight ahead of the learner, per actor thread. Episode k plays
+// with the weights the learner had after episode k - window, where window is
+// EPISODES_PER_THREAD * --threads, so a seed gives the same run for a given
+// thread count (but not across thread counts).
+const int EPISODES_PER_THREAD = 4;
+
+// A batch of experience from one actor. The last batch of an episode also
+// carries the episode's statistics.
+struct ActorBatch {
+  int episode = 0;
+  std::vector<Transition> transitions;
+  bool episodeEnd = false;
+  int steps = 0;
+  int score = 0;
+  double totalReward = 0.0;
+};
+
+// Bounded multi-producer queue feeding the learner
+class BatchQueue {
+public:
+  void push(ActorBatch &&batch) {
+    std::unique_lock<std::mutex> lock(mutex);
+    notFull.wait(lock, [this] { return batches.size() < QUEUE_CAPACITY; });
+    batches.push_back(std::move(batch));
+    notEmpty.notify_one();
+  }
+
+  ActorBatch pop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    notEmpty.wait(lock, [this] { return !batches.empty(); });
+    ActorBatch batch = std::move(batches.front());
+    batches.pop_front();
+    notFull.notify_one();
+    return batch;
+  }
+
+private:
+  std::mutex mutex;
+  std::condition_variable notEmpty, notFull;
+  std::deque<ActorBatch> batches;
+};
+
+// Parameters of the learner's network; actors need nothing else from it
+struct Parameters {
+  AlignedVector weights;
+  AlignedVector biases;
+};
+
+// Weights an episode plays with, tagged with the episode after which the
+// learner took them
+struct Snapshot {
+  std::shared_ptr<const Parameters> parameters;
+  int version;
+};
+
+Snapshot takeSnapshot(const NeuralNetwork &nn, int version) {
+  return {std::make_shared<const Parameters>(
+              Parameters{nn.getWeightBuffer(), nn.getBiasBuffer()}),
+          version};
+}
+
+// Per-thread actor state, reused across the episodes the thread runs
+struct Actor {
+  NeuralNetwork nn{NETWORK_TOPOLOGY, 0};
+  int version = -1;
+  SnakeGame game{20, 40, 0};
+};
+
+// Play one episode with the actor's copy of the network. Food and
+// exploration come from the episode's own streams and epsilon from its index,
+// whichever actor plays it.
+void runEpisode(Actor &actor, const Snapshot &weights, BatchQueue &queue,
+                uint64_t seed, int episode) {
+  if (weights.version != actor.version) {
+    actor.nn.setParameters(weights.parameters->weights.data(),
+                           weights.parameters->biases.data());
+    actor.version = weights.version;
+  }
+
+  Rng rng(seed, Stream::EXPLORATION, episode);
+  SnakeGame &game = actor.game;
+  game.seed(Rng::streamKey(seed, Stream::GAME, episode));
+  game.reset();
+
+  const double epsilon = episodeExplorationRate(episode);
+  ActorBatch batch;
+  batch.episode = episode;
+  batch.transitions.reserve(ACTOR_BATCH_SIZE);
+  int steps = 0;
+  int lastScore = game.getScore();
+  double totalReward = 0.0;
+
+  while (!game.isGameOver()) {
+    Transition t;
+    game.getGameState(t.state);
+
+    // Choose action with epsilon-greedy strategy
+    if (rng.uniform() < epsilon) {
+      t.action = static_cast<int>(rng.below(4));
+    } else {
+      t.action = actor.nn.getAction(t.state);
+    }
+
+    game.step(static_cast<SnakeGame::Direction>(t.action));
+
+    // Same reward shaping as trainAI()
+    double reward = game.calculateReward();
+    if (reward == 1.0) {
+      lastScore = game.getScore();
+    }
+    if (steps % 100 == 0 && lastScore == game.getScore()) {
+      reward += -1.0;
+    }
+    totalReward += reward;
+
+    game.getGameState(t.nextState);
+    t.reward = reward;
+    t.done = game.isGameOver();
+    batch.transitions.push_back(t);
+    steps++;
+
+    if (batch.transitions.size() == ACTOR_BATCH_SIZE && !game.isGameOver()) {
+      queue.push(std::move(batch));
+      batch = ActorBatch();
+      batch.episode = episode;
+      batch.transitions.reserve(ACTOR_BATCH_SIZE);
+    }
+  }
+
+  batch.episodeEnd = true;
+  batch.steps = steps;
+  batch.score = game.getScore();
+  batch.totalReward = totalReward;
+  queue.push(std::move(batch));
+}
+
+} // namespace
+
+void trainAIParallel(const TrainOptions &options) {
+  int episodes = options.episodes;
+  int threads = options.threads;
+  const int window = EPISODES_PER_THREAD * threads;
+  NeuralNetwork nn(NETWORK_TOPOLOGY,
+                   Rng::streamKey(options.seed, Stream::NETWORK_INIT));
+
+  bool weightsLoaded = nn.loadWeights(WEIGHTS_FILE);
+  if (weightsLoaded) {
+    std::cout << "Loaded existing weights from " << WEIGHTS_FILE << std::endl;
+  }
+  if (options.targetSync > 0) {
+    nn.enableTargetNetwork(options.targetSync, options.doubleDQN);
+  }
+
+  TrainingProgress progress;
+  if (options.resume) {
+    Checkpointer::resume(CHECKPOINT_PREFIX, nn, progress);
+  }
+  Checkpointer checkpointer(CHECKPOINT_PREFIX, WEIGHTS_FILE,
+                            options.keepCheckpoints);
+
+  BatchQueue queue;
+
+  std::unique_ptr<ReplayLearner> replay;
+  if (options.replayCapacity > 0) {
+    replay = std::make_unique<ReplayLearner>(
+        options.replayCapacity, Rng::streamKey(options.seed, Stream::REPLAY),
+        options.prioritized);
+  }
+
+  // Transitions are recorded by the learner, in training order
+  std::unique_ptr<TransitionLogWriter> recorder;
+  if (!options.recordFile.empty()) {
+    recorder = std::make_unique<TransitionLogWriter>(options.recordFile);
+    if (!recorder->isOpen()) {
+      return;
+    }
+  }
+
+  // One actor per worker thread
+  std::vector<std::unique_ptr<Actor>> actors;
+  for (int i = 0; i < threads; ++i) {
+    actors.push_back(std::make_unique<Actor>());
+  }
+
+  // Episodes are independent tasks; idle actors steal queued episodes from
+  // busy ones, so a few very long games don't leave threads idle. The
+  // learner submits each episode once its weights are known.
+  WorkStealingPool pool(threads);
+  auto submit = [&](int episode, const Snapshot &weights) {
+    pool.submit([&, episode, weights] {
+      Actor &actor = *actors[WorkStealingPool::currentWorker()];
+      runEpisode(actor, weights, queue, options.seed, episode);
+    });
+  };
+  int finished = progress.episode;
+  Snapshot initial = takeSnapshot(nn, finished);
+  for (int episode = finished;
+       episode < std::min(episodes, finished + window); ++episode) {
+    submit(episode, initial);
+  }
+
+  // Learner: train on transitions in episode order, holding back batches of
+  // later episodes that finish first, so a run is reproducible from its seed
+  long totalSteps = progress.totalSteps;
+  std::map<int, std::deque<ActorBatch>> waiting;
+  while (finished < episodes) {
+    ActorBatch batch;
+    auto held = waiting.find(finished);
+    if (held != waiting.end()) {
+      batch = std::move(held->second.front());
+      held->second.pop_front();
+      if (held->second.empty()) {
+        waiting.erase(held);
+      }
+    } else {
+      batch = queue.pop();
+      if (batch.episode != finished) {
+        waiting[batch.episode].push_back(std::move(batch));
+        continue;
+      }
+    }
+
+    for (const Transition &t : batch.transitions) {
+      if (recorder) {
+        recorder->append(t);
+      }
+      if (replay) {
+        replay->observe(t, nn, DISCOUNT_FACTOR, LEARNING_RATE);
+      } else {
+        nn.updateQValues(t.state, t.action, t.reward, t.nextState, t.done,
+                         DISCOUNT_FACTOR, LEARNING_RATE);
+      }
+      totalSteps++;
+    }
+
+    if (batch.episodeEnd) {
+      std::printf("Episode %d complete: Steps = %d, Score = %d, Total Reward = "
+                  "%.2f Error: %lf\n",
+                  finished + 1, batch.steps, batch.score, batch.totalReward,
+                  nn.getError());
+
+      progress = {finished + 1, totalSteps,
+                  episodeExplorationRate(finished + 1)};
+      if (finished % CHECKPOINT_INTERVAL == 0 && finished > 0) {
+        checkpointer.save(nn, progress);
+      }
+      if ((finished + 1) % PROFILE_REPORT_INTERVAL == 0) {
+        PROFILE_REPORT();
+      }
+      finished++;
+
+      if (finished + window - 1 < episodes) {
+        submit(finished + window - 1, takeSnapshot(nn, finished));
+      }
+    }
+  }
+
+  pool.wait();
+
+  std::cout << "Total steps across all episodes: " << totalSteps << std::endl;
+
+  // Final save
+  checkpointer.save(nn, progress);
+  checkpointer.flush();
+  PROFILE_REPORT();
+  std::cout << "Training completed. Final weights saved to " << WEIGHTS_FILE
+            << std::endl;
+}
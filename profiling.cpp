@@ -0,0 +1,129 @@
+#include "profiling.h"
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace profiling {
+
+namespace {
+
+const char *const PHASE_NAMES[PHASE_COUNT] = {
+    "game_update",    "game_state", "action",      "feed_forward",
+    "back_propagate", "q_update",   "save_weights"};
+
+// Per-phase totals merged over threads
+struct Totals {
+  uint64_t count = 0;
+  uint64_t ticks = 0;
+  uint64_t buckets[BUCKETS] = {};
+};
+
+// Registered threads (kept after a thread exits so its counts still
+// report), the totals at the previous report, and the tick rate reference
+struct Registry {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<ThreadStats>> threads;
+  Totals previous[PHASE_COUNT];
+  uint64_t startTicks = now();
+  std::chrono::steady_clock::time_point startTime =
+      std::chrono::steady_clock::now();
+};
+
+Registry &registry() {
+  static Registry instance;
+  return instance;
+}
+
+// Smallest value that falls in bucket
+uint64_t bucketStart(int bucket) {
+  if (bucket < SUB) {
+    return bucket;
+  }
+  int group = bucket / SUB;
+  return static_cast<uint64_t>(SUB + bucket % SUB) << (group - 1);
+}
+
+// Value below which fraction of the samples fall, as the midpoint of its
+// bucket
+double percentile(const uint64_t *buckets, uint64_t count, double fraction) {
+  uint64_t rank = static_cast<uint64_t>(fraction * (count - 1));
+  uint64_t seen = 0;
+  for (int b = 0; b < BUCKETS; ++b) {
+    seen += buckets[b];
+    if (seen > rank) {
+      return 0.5 * (bucketStart(b) + (b + 1 < BUCKETS ? bucketStart(b + 1)
+                                                      : bucketStart(b)));
+    }
+  }
+  return 0.0;
+}
+
+} // namespace
+
+ThreadStats *registerThread() {
+  Registry &r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  r.threads.push_back(std::make_unique<ThreadStats>());
+  return r.threads.back().get();
+}
+
+void report(std::FILE *out) {
+  Registry &r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+
+  // Nanoseconds per tick, measured against the steady clock since startup
+  double elapsedNs = std::chrono::duration<double, std::nano>(
+                         std::chrono::steady_clock::now() - r.startTime)
+                         .count();
+  uint64_t elapsedTicks = now() - r.startTicks;
+  double nsPerTick = elapsedTicks > 0 ? elapsedNs / elapsedTicks : 1.0;
+
+  std::fprintf(out, "%-15s %10s %10s %9s %9s %9s %9s %9s %9s\n", "phase",
+               "calls", "total ms", "mean ns", "p50", "p90", "p99", "p99.9",
+               "max");
+  for (int phase = 0; phase < PHASE_COUNT; ++phase) {
+    Totals current;
+    for (const auto &thread : r.threads) {
+      const PhaseStats &stats = thread->phases[phase];
+      current.count += stats.count.load(std::memory_order_relaxed);
+      current.ticks += stats.ticks.load(std::memory_order_relaxed);
+      for (int b = 0; b < BUCKETS; ++b) {
+        current.buckets[b] += stats.buckets[b].load(std::memory_order_relaxed);
+      }
+    }
+
+    // Activity since the previous report
+    Totals &previous = r.previous[phase];
+    Totals delta;
+    delta.count = current.count - previous.count;
+    delta.ticks = current.ticks - previous.ticks;
+    int highest = 0;
+    for (int b = 0; b < BUCKETS; ++b) {
+      delta.buckets[b] = current.buckets[b] - previous.buckets[b];
+      if (delta.buckets[b]) {
+        highest = b;
+      }
+    }
+    previous = current;
+
+    if (delta.count == 0) {
+      continue;
+    }
+    double maxTicks =
+        highest + 1 < BUCKETS ? bucketStart(highest + 1) : bucketStart(highest);
+    std::fprintf(out, "%-15s %10llu %10.2f %9.1f %9.0f %9.0f %9.0f %9.0f %9.0f\n",
+                 PHASE_NAMES[phase],
+                 static_cast<unsigned long long>(delta.count),
+                 delta.ticks * nsPerTick / 1e6,
+                 delta.ticks * nsPerTick / delta.count,
+                 percentile(delta.buckets, delta.count, 0.5) * nsPerTick,
+                 percentile(delta.buckets, delta.count, 0.9) * nsPerTick,
+                 percentile(delta.buckets, delta.count, 0.99) * nsPerTick,
+                 percentile(delta.buckets, delta.count, 0.999) * nsPerTick,
+                 maxTicks * nsPerTick);
+  }
+  std::fflush(out);
+}
+
+} // namespace profiling
@@ -0,0 +1,128 @@
+#ifndef PROFILING_H
+#define PROFILING_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Hot-path timers. PROFILE_SCOPE(PHASE) times the rest of the enclosing
+// scope into a per-thread histogram for that phase; PROFILE_REPORT() prints
+// call counts, totals and latency percentiles for every phase since the last
+// report. Both compile to nothing unless SNAKE_PROFILE is defined (CMake
+// option SNAKE_PROFILE). Phases nest, so times are inclusive: a Q update
+// includes the forward passes it runs. Batched calls (VecSnakeEnv, batch
+// actions and updates) count once per call. Percentiles and max are
+// accurate to one histogram bucket.
+namespace profiling {
+
+enum Phase {
+  GAME_UPDATE,    // SnakeGame::update(), VecSnakeEnv::step()
+  GAME_STATE,     // SnakeGame::getGameState(), VecSnakeEnv::getStates()
+  ACTION,         // NeuralNetwork::getAction() and getActionBatch()
+  FEED_FORWARD,   // NeuralNetwork::feedForward()
+  BACK_PROPAGATE, // NeuralNetwork::backPropagate()
+  Q_UPDATE,       // NeuralNetwork::updateQValues() and the batched version
+  SAVE_WEIGHTS,   // WeightsFile::save(), including checkpoints
+  PHASE_COUNT
+};
+
+// Log-linear histogram buckets: values below SUB are exact, above that each
+// power of two is split into SUB buckets, so a bucket is within 12.5% of
+// any value in it
+constexpr int SUB_BITS = 3;
+constexpr int SUB = 1 << SUB_BITS;
+constexpr int BUCKETS = (64 - SUB_BITS + 1) * SUB;
+
+inline int bucketOf(uint64_t ticks) {
+  if (ticks < SUB) {
+    return static_cast<int>(ticks);
+  }
+  int msb = 63 - __builtin_clzll(ticks);
+  return (msb - SUB_BITS + 1) * SUB +
+         static_cast<int>((ticks >> (msb - SUB_BITS)) & (SUB - 1));
+}
+
+// Counters of one phase on one thread. Only the owning thread writes, with
+// plain relaxed load/store pairs rather than atomic increments; report()
+// reads them from another thread.
+struct PhaseStats {
+  std::atomic<uint64_t> count{0};
+  std::atomic<uint64_t> ticks{0};
+  std::atomic<uint64_t> buckets[BUCKETS] = {};
+};
+
+struct ThreadStats {
+  PhaseStats phases[PHASE_COUNT];
+};
+
+// The calling thread's counters, registered on first use. A plain pointer
+// needs no thread_local initialization guard on every access.
+ThreadStats *registerThread();
+inline thread_local ThreadStats *currentThreadStats = nullptr;
+inline ThreadStats &threadStats() {
+  if (!currentThreadStats) {
+    currentThreadStats = registerThread();
+  }
+  return *currentThreadStats;
+}
+
+// Timestamp in clock ticks: the TSC on x86, nanoseconds elsewhere
+inline uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+inline void add(std::atomic<uint64_t> &counter, uint64_t value) {
+  counter.store(counter.load(std::memory_order_relaxed) + value,
+                std::memory_order_relaxed);
+}
+
+inline void record(Phase phase, uint64_t ticks) {
+  PhaseStats &stats = threadStats().phases[phase];
+  add(stats.count, 1);
+  add(stats.ticks, ticks);
+  add(stats.buckets[bucketOf(ticks)], 1);
+}
+
+class ScopedTimer {
+public:
+  explicit ScopedTimer(Phase phase) : phase(phase), start(now()) {}
+  ~ScopedTimer() { record(phase, now() - start); }
+
+  ScopedTimer(const ScopedTimer &) = delete;
+  ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+private:
+  Phase phase;
+  uint64_t start;
+};
+
+// Print every phase's activity since the previous report (from all threads)
+void report(std::FILE *out = stdout);
+
+} // namespace profiling
+
+#ifdef SNAKE_PROFILE
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(phase)                                                   \
+  profiling::ScopedTimer PROFILE_CONCAT(profileTimer, __LINE__)(               \
+      profiling::phase)
+#define PROFILE_REPORT() profiling::report()
+#else
+#define PROFILE_SCOPE(phase) ((void)0)
+#define PROFILE_REPORT() ((void)0)
+#endif
+
+#endif // PROFILING_H
@@ -0,0 +1,275 @@
+#include "renderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+static bool ncursesInitialized = false;
+
+SnakeRenderer::SnakeRenderer(SnakeGame &game)
+    : game(game), screen(game.getHeight() * game.getWidth(), ' '),
+      frame(screen.size(), ' ') {
+  initNcurses();
+
+  // Create window
+  win = newwin(game.getHeight(), game.getWidth(), 0, 0);
+  box(win, 0, 0);
+  wrefresh(win);
+}
+
+SnakeRenderer::~SnakeRenderer() {
+  // Delete window but don't end ncurses
+  // This allows multiple games to be created and destroyed
+  delwin(win);
+}
+
+void SnakeRenderer::initNcurses() {
+  if (!ncursesInitialized) {
+    initscr();
+    cbreak();
+    noecho();
+    curs_set(0);          // Hide cursor
+    nodelay(stdscr, TRUE); // Poll input without waiting
+    keypad(stdscr, TRUE); // Enable keyboard mapping
+    ncursesInitialized = true;
+  }
+}
+
+bool SnakeRenderer::processInput(bool steer) {
+  int key;
+  while ((key = getch()) != ERR) {
+    SnakeGame::Direction turn;
+    switch (key) {
+    case KEY_UP:
+      turn = SnakeGame::UP;
+      break;
+    case KEY_RIGHT:
+      turn = SnakeGame::RIGHT;
+      break;
+    case KEY_DOWN:
+      turn = SnakeGame::DOWN;
+      break;
+    case KEY_LEFT:
+      turn = SnakeGame::LEFT;
+      break;
+    case 'q':
+    case 'Q':
+      return false;
+    default:
+      continue;
+    }
+    if (steer && turns.size() < MAX_QUEUED_TURNS) {
+      turns.push_back(turn);
+    }
+  }
+  return true;
+}
+
+void SnakeRenderer::put(int cell, char glyph) {
+  if (screen[cell] != glyph) {
+    screen[cell] = glyph;
+    int width = game.getWidth();
+    mvwaddch(win, cell / width, cell % width, glyph);
+  }
+}
+
+bool SnakeRenderer::drawMoves() {
+  const SnakeBody &snake = game.getSnake();
+  if (drawnBody.empty()) {
+    return false;
+  }
+
+  // The game's body is some new head segments followed by the front of the
+  // drawn body, whose remaining tail segments were vacated. None may be kept
+  // (a length-1 snake moving), and then every drawn segment is vacated.
+  size_t added = 0;
+  while (added < snake.size() && snake[added] != drawnBody.front()) {
+    added++;
+  }
+  size_t kept = snake.size() - added;
+  if (kept > drawnBody.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < kept; ++i) {
+    if (snake[added + i] != drawnBody[i]) {
+      return false;
+    }
+  }
+
+  for (size_t i = kept; i < drawnBody.size(); ++i) {
+    put(drawnBody[i], ' ');
+  }
+  drawnBody.resize(kept);
+
+  if (added > 0 && !drawnBody.empty()) {
+    put(drawnBody.front(), 'O');
+  }
+  for (size_t i = added; i-- > 0;) {
+    drawnBody.push_front(snake[i]);
+    put(snake[i], i == 0 ? '@' : 'O');
+  }
+  return true;
+}
+
+void SnakeRenderer::drawAll() {
+  const SnakeBody &snake = game.getSnake();
+  int height = game.getHeight();
+  int width = game.getWidth();
+
+  // Border, with the score rewritten over it
+  box(win, 0, 0);
+  drawnScore = -1;
+
+  // Interior cells that are not part of the snake or food are blank
+  std::fill(frame.begin(), frame.end(), ' ');
+  for (int cell : snake) {
+    frame[cell] = 'O';
+  }
+  frame[snake.front()] = '@';
+  for (int y = 1; y < height - 1; ++y) {
+    for (int x = 1; x < width - 1; ++x) {
+      put(y * width + x, frame[y * width + x]);
+    }
+  }
+
+  drawnBody.assign(snake.begin(), snake.end());
+  drawnFood = {-1, -1};
+}
+
+void SnakeRenderer::render() {
+  int width = game.getWidth();
+  std::pair<int, int> food = game.getFood();
+
+  // Snake, falling back to a full diff when it cannot be advanced
+  if (!drawMoves()) {
+    drawAll();
+  }
+
+  // Food, clearing the old one unless the snake now covers it
+  if (food != drawnFood) {
+    if (drawnFood.first >= 0) {
+      int cell = drawnFood.first * width + drawnFood.second;
+      if (screen[cell] == '*') {
+        put(cell, ' ');
+      }
+    }
+    put(food.first * width + food.second, '*');
+    drawnFood = food;
+  }
+
+  // Score; a shorter number needs the border under the old one back
+  if (game.getScore() != drawnScore) {
+    if (game.getScore() < drawnScore) {
+      box(win, 0, 0);
+    }
+    drawnScore = game.getScore();
+    mvwprintw(win, 0, 2, "Score: %d", drawnScore);
+  }
+
+  // Send all changed cells in one update
+  wnoutrefresh(win);
+  doupdate();
+}
+
+void SnakeRenderer::invalidate() {
+  std::fill(screen.begin(), screen.end(), 0);
+  drawnBody.clear();
+}
+
+void SnakeRenderer::advance(const Controller &controller) {
+  if (controller) {
+    controller(game);
+  } else if (!turns.empty()) {
+    game.setDirection(turns.front());
+    turns.pop_front();
+  }
+  game.update();
+}
+
+bool SnakeRenderer::run(const LoopOptions &options,
+                        const Controller &controller) {
+  render();
+  long ticks = 0;
+  long drawnTicks = 0;
+
+  if (options.fastForward > 0) {
+    while (!game.isGameOver()) {
+      advance(controller);
+      if (++ticks % options.fastForward == 0) {
+        if (!processInput(!controller)) {
+          return false;
+        }
+        render();
+      }
+    }
+    render();
+    return true;
+  }
+
+  using Clock = std::chrono::steady_clock;
+  const Clock::duration tick = std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double>(1.0 / options.tickRate));
+  const Clock::duration frame = std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double>(1.0 / options.maxFps));
+
+  // Ticks run back to back to catch up after a stall (e.g. a slow terminal)
+  // before the schedule is reset, so the snake never jumps far
+  const int MAX_CATCH_UP = 5;
+
+  Clock::time_point nextTick = Clock::now() + tick;
+  Clock::time_point nextFrame = Clock::now();
+  while (!game.isGameOver()) {
+    if (!processInput(!controller)) {
+      return false;
+    }
+
+    Clock::time_point now = Clock::now();
+    for (int caughtUp = 1; now >= nextTick && !game.isGameOver(); ++caughtUp) {
+      advance(controller);
+      ticks++;
+      nextTick = caughtUp < MAX_CATCH_UP ? nextTick + tick : now + tick;
+    }
+
+    // Draw when something changed, at most maxFps times a second
+    if (ticks != drawnTicks && now >= nextFrame) {
+      render();
+      drawnTicks = ticks;
+      nextFrame = now + frame;
+    }
+
+    // Sleep until the next tick, or the next frame if one is waiting
+    Clock::time_point wake = nextTick;
+    if (ticks != drawnTicks) {
+      wake = std::min(wake, nextFrame);
+    }
+    std::this_thread::sleep_until(wake);
+  }
+
+  render();
+  return true;
+}
+
+void SnakeRenderer::showGameOver() {
+  int height = game.getHeight();
+  int width = game.getWidth();
+
+  // Game over message
+  mvwprintw(win, height / 2, width / 2 - 5, "GAME OVER!");
+  mvwprintw(win, height / 2 + 1, width / 2 - 7, "Final score: %d",
+            game.getScore());
+  mvwprintw(win, height / 2 + 2, width / 2 - 11, "Press any key to exit...");
+  wrefresh(win);
+  invalidate();
+
+  nodelay(stdscr, FALSE); // Wait for key press
+  getch();
+  nodelay(stdscr, TRUE); // Reset to non-blocking mode for next game
+}
+
+// Add clean exit method to properly end ncurses when the program exits
+void SnakeRenderer::cleanupNcurses() {
+  if (ncursesInitialized) {
+    endwin();
+    ncursesInitialized = false;
+  }
+}
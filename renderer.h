@@ -0,0 +1,96 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include "snake.h"
+#include <deque>
+#include <functional>
+#include <ncurses.h>
+#include <utility>
+#include <vector>
+
+// Pacing for SnakeRenderer::run(). The game advances tickRate times a second
+// and is drawn at most maxFps times a second, independently of each other.
+// With fastForward > 0 the game instead runs as fast as it can and only
+// every fastForward-th tick is drawn (input is polled at the same points).
+struct LoopOptions {
+  double tickRate = 10.0;
+  double maxFps = 60.0;
+  int fastForward = 0;
+};
+
+// ncurses view of a SnakeGame. The game never calls into the renderer; a
+// renderer observes the game and is only created when something is drawn.
+// Frames are differential: the renderer remembers what it drew and only
+// rewrites the cells that changed (new head, old head, vacated tail, food,
+// score), then flushes them in a single terminal update.
+class SnakeRenderer {
+public:
+  // Constructor and destructor
+  SnakeRenderer(SnakeGame &game);
+  ~SnakeRenderer();
+
+  // Draw the current game state
+  void render();
+
+  // Redraw every cell on the next render() (e.g. after the window was
+  // overwritten)
+  void invalidate();
+
+  // Read all pending keys without waiting. When steer is set, arrows are
+  // queued as turns and applied one per tick, so two quick presses cannot
+  // reverse the snake into itself. Returns false if 'q' was pressed.
+  bool processInput(bool steer = true);
+
+  // Called once per tick before the game advances, e.g. to let a policy
+  // choose the direction
+  using Controller = std::function<void(SnakeGame &)>;
+
+  // Play until the game ends (returns true) or 'q' is pressed (returns
+  // false). Without a controller the keyboard steers.
+  bool run(const LoopOptions &options = LoopOptions(),
+           const Controller &controller = nullptr);
+
+  // Show the game over message
+  void showGameOver();
+
+  // Clean up ncurses (call at program exit)
+  static void cleanupNcurses();
+
+private:
+  SnakeGame &game;
+
+  // Terminal window
+  WINDOW *win;
+
+  // Glyph on screen per cell (y * width + x); 0 when unknown
+  std::vector<char> screen;
+
+  // Scratch for drawAll(): the glyph every cell should show
+  std::vector<char> frame;
+
+  // Turns pressed but not yet applied, oldest first
+  static constexpr size_t MAX_QUEUED_TURNS = 3;
+  std::deque<SnakeGame::Direction> turns;
+
+  // Body cells as last drawn, head first, and the food and score shown
+  std::deque<uint16_t> drawnBody;
+  std::pair<int, int> drawnFood{-1, -1};
+  int drawnScore = -1;
+
+  static void initNcurses();
+
+  // One simulation tick; applies at most one queued turn
+  void advance(const Controller &controller);
+
+  // Write glyph at cell unless it is already on screen
+  void put(int cell, char glyph);
+
+  // Move the drawn snake to the game's. Returns false if the body cannot be
+  // reached by advancing the drawn one (new game, window overwritten).
+  bool drawMoves();
+
+  // Diff every cell against the screen
+  void drawAll();
+};
+
+#endif // RENDERER_H
@@ -0,0 +1,133 @@
+#include "replay_buffer.h"
+#include "nn.h"
+
+#include <algorithm>
+#include <cmath>
+
+void Minibatch::resize(size_t n) {
+  size = n;
+  states.resize(n * GAME_STATE_SIZE);
+  actions.resize(n);
+  rewards.resize(n);
+  nextStates.resize(n * GAME_STATE_SIZE);
+  dones.resize(n);
+  indices.resize(n);
+  weights.resize(n, 1.0);
+}
+
+ReplayBuffer::ReplayBuffer(size_t capacity)
+    : states(capacity * GAME_STATE_SIZE), actions(capacity),
+      rewards(capacity), nextStates(capacity * GAME_STATE_SIZE),
+      dones(capacity) {}
+
+void ReplayBuffer::add(const Transition &t) {
+  std::copy(t.state, t.state + GAME_STATE_SIZE,
+            &states[next * GAME_STATE_SIZE]);
+  std::copy(t.nextState, t.nextState + GAME_STATE_SIZE,
+            &nextStates[next * GAME_STATE_SIZE]);
+  actions[next] = t.action;
+  rewards[next] = t.reward;
+  dones[next] = t.done;
+
+  next = (next + 1) % capacity();
+  count = std::min(count + 1, capacity());
+}
+
+void ReplayBuffer::copyToBatch(size_t slot, size_t i, Minibatch &batch) const {
+  std::copy_n(&states[slot * GAME_STATE_SIZE], GAME_STATE_SIZE,
+              &batch.states[i * GAME_STATE_SIZE]);
+  std::copy_n(&nextStates[slot * GAME_STATE_SIZE], GAME_STATE_SIZE,
+              &batch.nextStates[i * GAME_STATE_SIZE]);
+  batch.actions[i] = actions[slot];
+  batch.rewards[i] = rewards[slot];
+  batch.dones[i] = dones[slot];
+  batch.indices[i] = slot;
+}
+
+void ReplayBuffer::sample(size_t batchSize, Rng &rng, Minibatch &batch) {
+  batch.resize(batchSize);
+  for (size_t i = 0; i < batchSize; ++i) {
+    copyToBatch(rng.below(count), i, batch);
+    batch.weights[i] = 1.0;
+  }
+}
+
+PrioritizedReplayBuffer::PrioritizedReplayBuffer(size_t capacity)
+    : ReplayBuffer(capacity), tree(capacity) {}
+
+void PrioritizedReplayBuffer::add(const Transition &t) {
+  tree.update(next, std::pow(maxPriority, ALPHA));
+  ReplayBuffer::add(t);
+}
+
+void PrioritizedReplayBuffer::sample(size_t batchSize, Rng &rng,
+                                     Minibatch &batch) {
+  batch.resize(batchSize);
+
+  // Stratified sampling: one draw from each of batchSize equal slices of the
+  // total priority
+  double total = tree.total();
+  double segment = total / batchSize;
+  double maxWeight = 0.0;
+
+  for (size_t i = 0; i < batchSize; ++i) {
+    size_t slot = tree.find(std::min((i + rng.uniform()) * segment, total));
+    if (slot >= count) {
+      slot = count - 1;
+    }
+    copyToBatch(slot, i, batch);
+
+    double probability = tree.get(slot) / total;
+    batch.weights[i] = std::pow(count * probability, -beta);
+    maxWeight = std::max(maxWeight, batch.weights[i]);
+  }
+
+  for (size_t i = 0; i < batchSize; ++i) {
+    batch.weights[i] /= maxWeight;
+  }
+}
+
+void PrioritizedReplayBuffer::updatePriorities(const Minibatch &batch,
+                                               const double *tdErrors) {
+  for (size_t i = 0; i < batch.size; ++i) {
+    double priority = std::abs(tdErrors[i]) + PRIORITY_EPSILON;
+    maxPriority = std::max(maxPriority, priority);
+    tree.update(batch.indices[i], std::pow(priority, ALPHA));
+  }
+}
+
+ReplayLearner::ReplayLearner(size_t capacity, uint64_t seed, bool prioritized)
+    : rng(seed) {
+  if (prioritized) {
+    auto buffer = std::make_unique<PrioritizedReplayBuffer>(capacity);
+    this->prioritized = buffer.get();
+    this->buffer = std::move(buffer);
+  } else {
+    buffer = std::make_unique<ReplayBuffer>(capacity);
+  }
+  batch.resize(BATCH_SIZE);
+  tdErrors.resize(BATCH_SIZE);
+}
+
+void ReplayLearner::observe(const Transition &t, NeuralNetwork &nn,
+                            double discount, double learningRate) {
+  buffer->add(t);
+  observed++;
+
+  if (buffer->size() < std::min(WARMUP, buffer->capacity()) ||
+      observed % TRAIN_INTERVAL != 0) {
+    return;
+  }
+
+  if (prioritized) {
+    double progress = std::min(1.0, (double)observed / BETA_STEPS);
+    prioritized->setBeta(BETA_START + (1.0 - BETA_START) * progress);
+  }
+
+  buffer->sample(BATCH_SIZE, rng, batch);
+  nn.updateQValuesBatch(batch.states.data(), batch.actions.data(),
+                        batch.rewards.data(), batch.nextStates.data(),
+                        batch.dones.data(), batch.size, discount, learningRate,
+                        batch.weights.data(), tdErrors.data());
+  buffer->updatePriorities(batch, tdErrors.data());
+}
@@ -0,0 +1,127 @@
+#ifndef REPLAY_BUFFER_H
+#define REPLAY_BUFFER_H
+
+#include "rng.h"
+#include "sum_tree.h"
+#include "transition.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class NeuralNetwork;
+
+// A minibatch of transitions in struct-of-arrays form, laid out for
+// NeuralNetwork::updateQValuesBatch(). Reused between samples.
+struct Minibatch {
+  size_t size = 0;
+  std::vector<double> states;     // [size x GAME_STATE_SIZE]
+  std::vector<int> actions;       // [size]
+  std::vector<double> rewards;    // [size]
+  std::vector<double> nextStates; // [size x GAME_STATE_SIZE]
+  std::vector<uint8_t> dones;     // [size]
+  std::vector<size_t> indices;    // Buffer slot of each sample
+  std::vector<double> weights;    // Importance-sampling weight of each sample
+
+  void resize(size_t n);
+};
+
+// Largest replay capacity accepted from the command line (--replay), about
+// 2.5 GB of transitions with prioritized replay
+const size_t MAX_REPLAY_CAPACITY = size_t(1) << 24;
+
+// Fixed-capacity experience replay. All storage is allocated up front as
+// struct-of-arrays; once full, new transitions overwrite the oldest.
+class ReplayBuffer {
+public:
+  // Constructor and destructor
+  explicit ReplayBuffer(size_t capacity);
+  virtual ~ReplayBuffer() = default;
+
+  // Store a transition
+  virtual void add(const Transition &t);
+
+  // Number of stored transitions
+  size_t size() const { return count; }
+  size_t capacity() const { return rewards.size(); }
+
+  // Fill batch with batchSize transitions drawn uniformly with replacement
+  // (all weights 1)
+  virtual void sample(size_t batchSize, Rng &rng, Minibatch &batch);
+
+  // Report the TD errors of a sampled batch (used by prioritized replay)
+  virtual void updatePriorities(const Minibatch &, const double *) {}
+
+protected:
+  // Copy slot into position i of batch
+  void copyToBatch(size_t slot, size_t i, Minibatch &batch) const;
+
+  // Slot the next add() writes to
+  size_t next = 0;
+  size_t count = 0;
+
+private:
+  std::vector<double> states;
+  std::vector<int> actions;
+  std::vector<double> rewards;
+  std::vector<double> nextStates;
+  std::vector<uint8_t> dones;
+};
+
+// Replay buffer sampling transitions in proportion to priority^ALPHA, where
+// the priority is the magnitude of the transition's last TD error. New
+// transitions get the current maximum priority so each is seen at least once.
+// Samples carry importance-sampling weights (N * P(i))^-beta, normalised by
+// their maximum, to correct for the non-uniform sampling.
+class PrioritizedReplayBuffer : public ReplayBuffer {
+public:
+  static constexpr double ALPHA = 0.6;
+  static constexpr double PRIORITY_EPSILON = 1e-3;
+
+  // Constructor
+  explicit PrioritizedReplayBuffer(size_t capacity);
+
+  void add(const Transition &t) override;
+  void sample(size_t batchSize, Rng &rng, Minibatch &batch) override;
+  void updatePriorities(const Minibatch &batch,
+                        const double *tdErrors) override;
+
+  // Importance-sampling exponent, annealed towards 1 during training
+  void setBeta(double b) { beta = b; }
+
+private:
+  SumTree tree;
+  double maxPriority = 1.0;
+  double beta = 0.4;
+};
+
+// Trains a network from a replay buffer: every transition is stored, and
+// once WARMUP transitions (or a full buffer, if smaller) are available a
+// minibatch update runs every TRAIN_INTERVAL transitions
+class ReplayLearner {
+public:
+  static constexpr size_t BATCH_SIZE = 64;
+  static constexpr size_t TRAIN_INTERVAL = 4;
+  static constexpr size_t WARMUP = 1000;
+
+  // Prioritized replay anneals beta from BETA_START to 1 over BETA_STEPS
+  static constexpr double BETA_START = 0.4;
+  static constexpr size_t BETA_STEPS = 100000;
+
+  // Constructor; minibatches are sampled from the stream keyed by seed
+  ReplayLearner(size_t capacity, uint64_t seed, bool prioritized = false);
+
+  // Store a transition and train when due
+  void observe(const Transition &t, NeuralNetwork &nn, double discount,
+               double learningRate);
+
+private:
+  std::unique_ptr<ReplayBuffer> buffer;
+  PrioritizedReplayBuffer *prioritized = nullptr; // Same object, if used
+  Minibatch batch;
+  std::vector<double> tdErrors;
+  Rng rng;
+  size_t observed = 0;
+};
+
+#endif // REPLAY_BUFFER_H
@@ -0,0 +1,77 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <cstdint>
+#include <random>
+
+// Seed-driven random numbers. A run has one seed; every consumer draws from
+// its own stream, keyed by the seed, a stream kind and an index (game,
+// episode, ...). Streams are counter based: value n of a stream is a
+// SplitMix64 hash of its key and n, so what one stream draws never depends
+// on how much any other stream drew or on which thread drew it, and a run
+// with a given seed replays exactly.
+//
+// Components that take a "seed" (SnakeGame, VecSnakeEnv, NeuralNetwork,
+// ReplayLearner) take a stream key from streamKey().
+enum class Stream : uint64_t {
+  GAME = 1,     // Food placement, per game or episode
+  NETWORK_INIT, // Initial weights
+  EXPLORATION,  // Epsilon-greedy actions, per episode or trainer
+  REPLAY,       // Replay minibatch sampling
+};
+
+class Rng {
+public:
+  // UniformRandomBitGenerator, so std distributions work too
+  using result_type = uint64_t;
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max() { return UINT64_MAX; }
+
+  explicit Rng(uint64_t key = 0) : key(key) {}
+  Rng(uint64_t seed, Stream stream, uint64_t index = 0)
+      : key(streamKey(seed, stream, index)) {}
+
+  // Key of stream number index of a kind for a run seed
+  static uint64_t streamKey(uint64_t seed, Stream stream, uint64_t index = 0) {
+    return mix(mix(seed ^ static_cast<uint64_t>(stream) * GOLDEN) + index);
+  }
+
+  // Restart the stream with another key
+  void seed(uint64_t newKey) {
+    key = newKey;
+    counter = 0;
+  }
+
+  uint64_t operator()() { return mix(key + ++counter * GOLDEN); }
+
+  // Uniform in [0, n), by multiply-shift (bias below n / 2^64)
+  uint64_t below(uint64_t n) {
+    return static_cast<uint64_t>(
+        (static_cast<unsigned __int128>((*this)()) * n) >> 64);
+  }
+
+  // Uniform in [0, 1), 53 random bits
+  double uniform() { return ((*this)() >> 11) * 0x1.0p-53; }
+
+  // SplitMix64 finalizer
+  static uint64_t mix(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+  }
+
+private:
+  static constexpr uint64_t GOLDEN = 0x9E3779B97F4A7C15ULL;
+
+  uint64_t key;
+  uint64_t counter = 0;
+};
+
+// Seed for runs without an explicit one, from the OS entropy source. The only
+// nondeterministic input; print it to make such a run repeatable.
+inline uint64_t randomSeed() {
+  std::random_device rd;
+  return (static_cast<uint64_t>(rd()) << 32) | rd();
+}
+
+#endif // RNG_H
@@ -1,31 +1,72 @@
 #include "snake.h"
+#include "profiling.h"
+#include <algorithm>
 #include <cmath>
 #include <cstdlib>
-#include <ctime>
-#include <ncurses.h>
-
-SnakeGame::SnakeGame(int h, int w)
-    : height(h), width(w), score(0), gameOver(false), direction(RIGHT) {
-  // Initialize ncurses
-  static bool ncursesInitialized = false;
-  if (!ncursesInitialized) {
-    initscr();
-    cbreak();
-    noecho();
-    curs_set(0);          // Hide cursor
-    timeout(100);         // Set input delay
-    keypad(stdscr, TRUE); // Enable keyboard mapping
-    ncursesInitialized = true;
+
+SnakeGame::SnakeGame(int h, int w) : SnakeGame(h, w, randomSeed()) {}
+
+SnakeGame::SnakeGame(int h, int w, uint64_t seed)
+    : height(h), width(w), score(0), gameOver(false), deathCause(NONE),
+      snake(static_cast<size_t>(h - 2) * (w - 2)),
+      occupancy((static_cast<size_t>(h) * w + 63) / 64, 0),
+      freeIndex(static_cast<size_t>(h) * w, -1), rng(seed), direction(RIGHT) {
+  freeCells.reserve(static_cast<size_t>(h - 2) * (w - 2));
+  reset();
+}
+
+void SnakeGame::seed(uint64_t seed) { rng.seed(seed); }
+
+bool SnakeGame::isOccupied(int y, int x) const {
+  if (y < 0 || y >= height || x < 0 || x >= width) {
+    return false;
+  }
+  size_t cell = static_cast<size_t>(y) * width + x;
+  return (occupancy[cell / 64] >> (cell % 64)) & 1;
+}
+
+void SnakeGame::setOccupied(int y, int x, bool occupied) {
+  int cell = y * width + x;
+  uint64_t bit = uint64_t(1) << (cell % 64);
+  if (occupied) {
+    occupancy[cell / 64] |= bit;
+
+    // Swap-remove the cell from the free list
+    int pos = freeIndex[cell];
+    int last = freeCells.back();
+    freeCells[pos] = last;
+    freeIndex[last] = pos;
+    freeCells.pop_back();
+    freeIndex[cell] = -1;
+  } else {
+    occupancy[cell / 64] &= ~bit;
+
+    freeIndex[cell] = static_cast<int>(freeCells.size());
+    freeCells.push_back(cell);
   }
+}
 
-  // Create window
-  win = newwin(height, width, 0, 0);
-  box(win, 0, 0);
-  wrefresh(win);
+void SnakeGame::reset() {
+  score = 0;
+  gameOver = false;
+  deathCause = NONE;
+  direction = RIGHT;
 
   // Initialize snake position at the center
   snake.clear(); // Clear any existing snake segments
-  snake.push_back(std::make_pair(height / 2, width / 4));
+  std::fill(occupancy.begin(), occupancy.end(), 0);
+
+  // Every interior cell starts free
+  freeCells.clear();
+  for (int y = 1; y < height - 1; ++y) {
+    for (int x = 1; x < width - 1; ++x) {
+      freeIndex[y * width + x] = static_cast<int>(freeCells.size());
+      freeCells.push_back(y * width + x);
+    }
+  }
+
+  snake.pushFront((height / 2) * width + width / 4);
+  setOccupied(height / 2, width / 4, true);
 
   // Place initial food
   placeFood();
@@ -34,64 +75,25 @@ SnakeGame::SnakeGame(int h, int w)
   prevDistanceToFood = getDistanceToFood();
 }
 
-SnakeGame::~SnakeGame() {
-  // Delete window but don't end ncurses
-  // This allows multiple games to be created and destroyed
-  delwin(win);
-}
-
 void SnakeGame::placeFood() {
-  // Generate random position for food that's not on the snake
-  int y, x;
-  bool validPosition;
-
-  do {
-    validPosition = true;
-    y = rand() % (height - 2) + 1;
-    x = rand() % (width - 2) + 1;
-
-    for (const auto &segment : snake) {
-      if (segment.first == y && segment.second == x) {
-        validPosition = false;
-        break;
-      }
-    }
-  } while (!validPosition);
-
-  food = std::make_pair(y, x);
-}
-
-void SnakeGame::processInput() {
-  int key = getch();
-
-  switch (key) {
-  case KEY_UP:
-    if (direction != DOWN)
-      direction = UP;
-    break;
-  case KEY_RIGHT:
-    if (direction != LEFT)
-      direction = RIGHT;
-    break;
-  case KEY_DOWN:
-    if (direction != UP)
-      direction = DOWN;
-    break;
-  case KEY_LEFT:
-    if (direction != RIGHT)
-      direction = LEFT;
-    break;
-  case 'q':
-  case 'Q':
+  // The snake fills the board, so there is nothing left to play for
+  if (freeCells.empty()) {
     gameOver = true;
-    break;
+    deathCause = BOARD_FULL;
+    return;
   }
+
+  // Pick a random free cell: O(1) however full the board is
+  int cell = freeCells[rng.below(freeCells.size())];
+  food = std::make_pair(cell / width, cell % width);
 }
 
 void SnakeGame::update() {
+  PROFILE_SCOPE(GAME_UPDATE);
+
   // Get head position
-  int headY = snake.front().first;
-  int headX = snake.front().second;
+  int headY = snake.front() / width;
+  int headX = snake.front() % width;
 
   // Update previous distance for next reward calculation
   prevDistanceToFood = getDistanceToFood();
@@ -117,19 +119,20 @@ void SnakeGame::update() {
   // Wall collision
   if (headY <= 0 || headY >= height - 1 || headX <= 0 || headX >= width - 1) {
     gameOver = true;
+    deathCause = WALL;
     return;
   }
 
-  // Self collision
-  for (const auto &segment : snake) {
-    if (headY == segment.first && headX == segment.second) {
-      gameOver = true;
-      return;
-    }
+  // Self collision (the tail still counts, as before it moves)
+  if (isOccupied(headY, headX)) {
+    gameOver = true;
+    deathCause = SELF;
+    return;
   }
 
   // Move snake
-  snake.push_front(std::make_pair(headY, headX));
+  snake.pushFront(headY * width + headX);
+  setOccupied(headY, headX, true);
 
   // Check if food is eaten
   if (headY == food.first && headX == food.second) {
@@ -137,67 +140,41 @@ void SnakeGame::update() {
     placeFood();
   } else {
     // If food not eaten, remove tail
-    snake.pop_back();
+    int tail = snake.back();
+    setOccupied(tail / width, tail % width, false);
+    snake.popBack();
   }
 }
 
-void SnakeGame::render() {
-  // Clear window
-  wclear(win);
-
-  // Draw border
-  box(win, 0, 0);
-
-  // Draw score
-  mvwprintw(win, 0, 2, "Score: %d", score);
-
-  // Draw snake
-  for (const auto &segment : snake) {
-    mvwaddch(win, segment.first, segment.second, 'O');
-  }
-
-  // Make head distinct
-  mvwaddch(win, snake.front().first, snake.front().second, '@');
-
-  // Draw food
-  mvwaddch(win, food.first, food.second, '*');
-
-  // Refresh window
-  wrefresh(win);
-}
-
 bool SnakeGame::isGameOver() const { return gameOver; }
 
 int SnakeGame::getScore() const { return score; }
 
-void SnakeGame::run(bool aiMode) {
-  while (!gameOver) {
-    if (!aiMode) {
-      processInput();
-    }
-    update();
-    render();
-    napms(10); // Sleep for smoother gameplay
-  }
-
-  // Game over message
-  mvwprintw(win, height / 2, width / 2 - 5, "GAME OVER!");
-  mvwprintw(win, height / 2 + 1, width / 2 - 7, "Final score: %d", score);
-  mvwprintw(win, height / 2 + 2, width / 2 - 11, "Press any key to exit...");
-  wrefresh(win);
+void SnakeGame::step(Direction dir) {
+  setDirection(dir);
+  update();
+}
 
-  nodelay(stdscr, FALSE); // Wait for key press
-  getch();
-  nodelay(stdscr, TRUE); // Reset to non-blocking mode for next game
+void SnakeGame::quit() {
+  gameOver = true;
+  deathCause = QUIT;
 }
 
 // AI-specific methods
 std::vector<double> SnakeGame::getGameState() const {
-  std::vector<double> state(8, 0.0);
+  std::vector<double> state(STATE_SIZE);
+  getGameState(state.data());
+  return state;
+}
+
+void SnakeGame::getGameState(double *state) const {
+  PROFILE_SCOPE(GAME_STATE);
+
+  std::fill(state, state + STATE_SIZE, 0.0);
 
   // Head position
-  int headY = snake.front().first;
-  int headX = snake.front().second;
+  int headY = snake.front() / width;
+  int headX = snake.front() % width;
 
   // 1-4: Danger straight, right, left
   switch (direction) {
@@ -223,45 +200,41 @@ std::vector<double> SnakeGame::getGameState() const {
     break;
   }
 
-  // Check for self-collision in those directions
-  for (size_t i = 1; i < snake.size(); i++) {
-    int segY = snake[i].first;
-    int segX = snake[i].second;
-
-    switch (direction) {
-    case UP:
-      if (headY - 1 == segY && headX == segX)
-        state[0] = 1.0;
-      if (headY == segY && headX + 1 == segX)
-        state[1] = 1.0;
-      if (headY == segY && headX - 1 == segX)
-        state[2] = 1.0;
-      break;
-    case RIGHT:
-      if (headY == segY && headX + 1 == segX)
-        state[0] = 1.0;
-      if (headY + 1 == segY && headX == segX)
-        state[1] = 1.0;
-      if (headY - 1 == segY && headX == segX)
-        state[2] = 1.0;
-      break;
-    case DOWN:
-      if (headY + 1 == segY && headX == segX)
-        state[0] = 1.0;
-      if (headY == segY && headX - 1 == segX)
-        state[1] = 1.0;
-      if (headY == segY && headX + 1 == segX)
-        state[2] = 1.0;
-      break;
-    case LEFT:
-      if (headY == segY && headX - 1 == segX)
-        state[0] = 1.0;
-      if (headY - 1 == segY && headX == segX)
-        state[1] = 1.0;
-      if (headY + 1 == segY && headX == segX)
-        state[2] = 1.0;
-      break;
-    }
+  // Check for self-collision in those directions. The neighbouring cells are
+  // never the head, so the occupancy bitboard answers directly.
+  switch (direction) {
+  case UP:
+    if (isOccupied(headY - 1, headX))
+      state[0] = 1.0;
+    if (isOccupied(headY, headX + 1))
+      state[1] = 1.0;
+    if (isOccupied(headY, headX - 1))
+      state[2] = 1.0;
+    break;
+  case RIGHT:
+    if (isOccupied(headY, headX + 1))
+      state[0] = 1.0;
+    if (isOccupied(headY + 1, headX))
+      state[1] = 1.0;
+    if (isOccupied(headY - 1, headX))
+      state[2] = 1.0;
+    break;
+  case DOWN:
+    if (isOccupied(headY + 1, headX))
+      state[0] = 1.0;
+    if (isOccupied(headY, headX - 1))
+      state[1] = 1.0;
+    if (isOccupied(headY, headX + 1))
+      state[2] = 1.0;
+    break;
+  case LEFT:
+    if (isOccupied(headY, headX - 1))
+      state[0] = 1.0;
+    if (isOccupied(headY - 1, headX))
+      state[1] = 1.0;
+    if (isOccupied(headY + 1, headX))
+      state[2] = 1.0;
+    break;
   }
 
   // 4-7: Direction
@@ -279,8 +252,6 @@ std::vector<double> SnakeGame::getGameState() const {
     state[7] = 3.0; // Food is left
   else if (food.second > headX)
     state[7] = 4.0; // Food is right
-
-  return state;
 }
 
 void SnakeGame::setDirection(Direction dir) {
@@ -292,8 +263,8 @@ void SnakeGame::setDirection(Direction dir) {
 }
 
 double SnakeGame::getDistanceToFood() const {
-  int headY = snake.front().first;
-  int headX = snake.front().second;
+  int headY = snake.front() / width;
+  int headX = snake.front() % width;
 
   // Manhattan distance (more appropriate for grid-based movement)
   return std::abs(headY - food.first) + std::abs(headX - food.second);
@@ -303,14 +274,18 @@ double SnakeGame::calculateReward() const {
   // Base reward
   double reward = 0.0;
 
+  // A snake filling the whole board has won, which pays like eating food
+  if (deathCause == BOARD_FULL) {
+    return 1.0;
+  }
+
   // If game over, large negative reward
   if (gameOver) {
     return -1.0;
   }
 
   // If food eaten, large positive reward
-  if (snake.size() > 1 && snake[0].first == food.first &&
-      snake[0].second == food.second) {
+  if (snake.size() > 1 && snake[0] == food.first * width + food.second) {
     return 1.0;
   }
 
@@ -325,8 +300,8 @@ double SnakeGame::calculateReward() const {
 }
 
 bool SnakeGame::willCollide(Direction dir) const {
-  int headY = snake.front().first;
-  int headX = snake.front().second;
+  int headY = snake.front() / width;
+  int headX = snake.front() % width;
 
   // Calculate potential new head position
   switch (dir) {
@@ -350,14 +325,5 @@ bool SnakeGame::willCollide(Direction dir) const {
   }
 
   // Self collision
-  for (const auto &segment : snake) {
-    if (headY == segment.first && headX == segment.second) {
-      return true;
-    }
-  }
-
-  return false;
+  return isOccupied(headY, headX);
 }
-
-// Add clean exit method to properly end ncurses when the program exits
-void SnakeGame::cleanupNcurses() { endwin(); }
@@ -1,43 +1,79 @@
 #ifndef SNAKE_H
 #define SNAKE_H
 
-#include <deque>
-#include <ncurses.h>
+#include "rng.h"
+#include "snake_body.h"
+#include "transition.h"
+#include <cstddef>
+#include <cstdint>
 #include <utility>
 #include <vector>
 
+// Headless snake simulation. It owns no terminal state, so training can step
+// it without a TTY; drawing is done by SnakeRenderer (renderer.h).
 class SnakeGame {
 public:
   // Directions
   enum Direction { UP = 0, RIGHT = 1, DOWN = 2, LEFT = 3 };
 
-  // Constructor and destructor
+  // Why a game ended (NONE while it is running)
+  enum DeathCause { NONE, WALL, SELF, BOARD_FULL, QUIT };
+
+  // Constructors. Food placement uses a per-game random stream, keyed by
+  // seed (see Rng::streamKey()) or randomly seeded.
   SnakeGame(int h, int w);
-  ~SnakeGame();
+  SnakeGame(int h, int w, uint64_t seed);
+
+  // Restart the food placement stream with another key
+  void seed(uint64_t seed);
+
+  // Start a new episode, reusing the existing game object
+  void reset();
 
   // Core gameplay methods
-  void processInput();
   void update();
-  void render();
+  void step(Direction dir);
+  void quit();
   bool isGameOver() const;
+  DeathCause getDeathCause() const { return deathCause; }
   int getScore() const;
-  void run(bool aiMode = false);
 
-  // AI-specific methods
+  // AI-specific methods. The pointer overload writes STATE_SIZE values into
+  // a caller-provided buffer.
+  static constexpr size_t STATE_SIZE = GAME_STATE_SIZE;
   std::vector<double> getGameState() const;
+  void getGameState(double *state) const;
   void setDirection(Direction dir);
   double calculateReward() const;
 
-  // Clean up ncurses (call at program exit)
-  static void cleanupNcurses();
+  // Read-only access for renderers
+  int getHeight() const { return height; }
+  int getWidth() const { return width; }
+  Direction getDirection() const { return direction; }
+  const SnakeBody &getSnake() const { return snake; }
+  std::pair<int, int> getFood() const { return food; }
 
 private:
   int height, width;
   int score;
   bool gameOver;
+  DeathCause deathCause;
+
+  // Snake body as cell indices (y * width + x), head first. Sized for the
+  // whole interior, so moving never allocates.
+  SnakeBody snake;
 
-  // Snake body as a deque of coordinates
-  std::deque<std::pair<int, int>> snake;
+  // Occupancy bitboard of the body, one bit per cell (y * width + x), kept in
+  // sync with snake so collision and danger checks are O(1)
+  std::vector<uint64_t> occupancy;
+
+  // Interior cells not covered by the body, and each cell's position in that
+  // list (-1 when occupied). Swap-remove keeps both O(1) to update.
+  std::vector<int> freeCells;
+  std::vector<int> freeIndex;
+
+  // Food placement stream
+  Rng rng;
 
   // Food position
   std::pair<int, int> food;
@@ -48,10 +84,9 @@ private:
   // Previous distance to food (for reward calculation)
   double prevDistanceToFood;
 
-  // Terminal window
-  WINDOW *win;
-
   // Internal methods
+  bool isOccupied(int y, int x) const;
+  void setOccupied(int y, int x, bool occupied);
   void placeFood();
   double getDistanceToFood() const;
   bool willCollide(Direction dir) const;
@@ -0,0 +1,85 @@
+#ifndef SNAKE_BODY_H
+#define SNAKE_BODY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+// Snake body as a fixed-capacity ring buffer of packed cell indices
+// (y * width + x, so boards up to 65536 cells). Element 0 is the head.
+// Storage is allocated once; pushFront() and popBack() only move indices.
+class SnakeBody {
+public:
+  class const_iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = uint16_t;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const uint16_t *;
+    using reference = uint16_t;
+
+    const_iterator(const SnakeBody *body, size_t index)
+        : body(body), index(index) {}
+    uint16_t operator*() const { return (*body)[index]; }
+    const_iterator &operator++() {
+      ++index;
+      return *this;
+    }
+    bool operator==(const const_iterator &other) const {
+      return index == other.index;
+    }
+    bool operator!=(const const_iterator &other) const {
+      return index != other.index;
+    }
+
+  private:
+    const SnakeBody *body;
+    size_t index;
+  };
+
+  // Constructor: room for at least maxLength segments
+  explicit SnakeBody(size_t maxLength) {
+    size_t capacity = 1;
+    while (capacity < maxLength) {
+      capacity *= 2;
+    }
+    cells.resize(capacity);
+    mask = capacity - 1;
+  }
+
+  void clear() {
+    head = 0;
+    length = 0;
+  }
+
+  // Add a new head segment
+  void pushFront(uint16_t cell) {
+    head = (head - 1) & mask;
+    cells[head] = cell;
+    length++;
+  }
+
+  // Remove the tail segment
+  void popBack() { length--; }
+
+  uint16_t front() const { return cells[head]; }
+  uint16_t back() const { return cells[(head + length - 1) & mask]; }
+
+  // Segment i counted from the head
+  uint16_t operator[](size_t i) const { return cells[(head + i) & mask]; }
+
+  size_t size() const { return length; }
+  bool empty() const { return length == 0; }
+
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, length); }
+
+private:
+  std::vector<uint16_t> cells; // Power-of-two sized
+  size_t mask = 0;
+  size_t head = 0;
+  size_t length = 0;
+};
+
+#endif // SNAKE_BODY_H
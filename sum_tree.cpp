@@ -0,0 +1,35 @@
+#include "sum_tree.h"
+
+SumTree::SumTree(size_t capacity) : slotCount(capacity), leafCount(1) {
+  while (leafCount < capacity) {
+    leafCount *= 2;
+  }
+  nodes.assign(2 * leafCount, 0.0);
+}
+
+void SumTree::update(size_t slot, double priority) {
+  // Recompute sums from the children rather than adding the difference, so
+  // rounding errors don't accumulate over millions of updates
+  size_t node = leafCount + slot;
+  nodes[node] = priority;
+  for (node /= 2; node >= 1; node /= 2) {
+    nodes[node] = nodes[2 * node] + nodes[2 * node + 1];
+  }
+}
+
+size_t SumTree::find(double value) const {
+  size_t node = 1;
+  while (node < leafCount) {
+    size_t left = 2 * node;
+    if (value < nodes[left] || nodes[left + 1] <= 0.0) {
+      node = left;
+    } else {
+      value -= nodes[left];
+      node = left + 1;
+    }
+  }
+
+  // Rounding can walk past the last used slot; clamp to it
+  size_t slot = node - leafCount;
+  return slot < slotCount ? slot : slotCount - 1;
+}
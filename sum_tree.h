@@ -0,0 +1,38 @@
+#ifndef SUM_TREE_H
+#define SUM_TREE_H
+
+#include <cstddef>
+#include <vector>
+
+// Binary tree of partial sums over a fixed number of non-negative
+// priorities. Updating a priority and finding the slot that covers a given
+// prefix sum are both O(log n).
+class SumTree {
+public:
+  // Constructor
+  explicit SumTree(size_t capacity);
+
+  // Set the priority of a slot
+  void update(size_t slot, double priority);
+
+  // Priority of a slot
+  double get(size_t slot) const { return nodes[leafCount + slot]; }
+
+  // Sum of all priorities
+  double total() const { return nodes[1]; }
+
+  // Slot whose cumulative priority range contains value (0 <= value < total)
+  size_t find(double value) const;
+
+  size_t capacity() const { return slotCount; }
+
+private:
+  size_t slotCount;
+  size_t leafCount; // Power of two >= slotCount
+
+  // Heap layout: root at 1, children of i at 2i and 2i + 1, leaves from
+  // leafCount
+  std::vector<double> nodes;
+};
+
+#endif // SUM_TREE_H
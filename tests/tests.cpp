@@ -0,0 +1,569 @@
+// Equivalence and file format tests for the optimized paths, one ctest case
+// each (see CMakeLists.txt).
+//
+//   snake_tests [NAME]
+//
+// Runs the named test, or every test. Files are written to the working
+// directory. Exits with status 1 if any check fails, or SKIPPED if a test
+// could not run here (e.g. an instruction set the CPU lacks).
+
+#include "aligned.h"
+#include "fixed_network.h"
+#include "inference.h"
+#include "kernels.h"
+#include "nn.h"
+#include "rng.h"
+#include "snake.h"
+#include "training.h"
+#include "transition_log.h"
+#include "vec_env.h"
+#include "weights_file.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+const uint64_t TEST_SEED = 1;
+
+// Exit status for ctest's SKIP_RETURN_CODE
+const int SKIPPED = 77;
+
+int failures = 0;
+bool skipped = false;
+
+void check(bool ok, const std::string &what) {
+  if (!ok) {
+    std::printf("  FAILED: %s\n", what.c_str());
+    failures++;
+  }
+}
+
+// |actual - expected| within tolerance, relative for large values
+void checkNear(double actual, double expected, double tolerance,
+               const std::string &what) {
+  double error = std::abs(actual - expected);
+  if (!(error <= tolerance * std::max(1.0, std::abs(expected)))) {
+    std::printf("  FAILED: %s: %.17g vs %.17g\n", what.c_str(), actual,
+                expected);
+    failures++;
+  }
+}
+
+// Random values in [-range, range) for the first n entries of a padded buffer
+template <typename Vector>
+void fill(Vector &v, size_t n, Rng &rng, double range) {
+  for (size_t i = 0; i < n; ++i) {
+    v[i] = static_cast<typename Vector::value_type>(
+        range * (2.0 * rng.uniform() - 1.0));
+  }
+}
+
+// Game states from uniformly random play, row-major
+std::vector<double> randomPlayStates(size_t count, uint64_t seed) {
+  std::vector<double> states;
+  SnakeGame game(20, 40, Rng::streamKey(seed, Stream::GAME));
+  Rng rng(seed, Stream::EXPLORATION);
+  double state[SnakeGame::STATE_SIZE];
+  while (states.size() < count * SnakeGame::STATE_SIZE) {
+    if (game.isGameOver()) {
+      game.reset();
+    }
+    game.getGameState(state);
+    states.insert(states.end(), state, state + SnakeGame::STATE_SIZE);
+    game.step(static_cast<SnakeGame::Direction>(rng.below(4)));
+  }
+  return states;
+}
+
+std::vector<char> readFile(const std::string &filename) {
+  std::ifstream file(filename, std::ios::binary);
+  return std::vector<char>(std::istreambuf_iterator<char>(file), {});
+}
+
+void writeFile(const std::string &filename, const std::vector<char> &bytes) {
+  std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+  file.write(bytes.data(), bytes.size());
+}
+
+// Every kernel of the selected instruction set (SNAKE_SIMD, kernels.h)
+// against the scalar reference, on padded buffers of several shapes
+void testKernels() {
+  const Kernels &k = kernels();
+  const Kernels &ref = scalarKernels();
+  const char *forced = std::getenv("SNAKE_SIMD");
+  if (forced && std::strcmp(forced, k.name) != 0) {
+    std::printf("  skipped: %s is not supported on this CPU\n", forced);
+    skipped = true;
+    return;
+  }
+  std::printf("  kernels: %s\n", k.name);
+  Rng rng(TEST_SEED);
+
+  const size_t shapes[][2] = {{1, 1}, {4, 8}, {16, 13}, {17, 30}, {64, 100}};
+  for (const auto &shape : shapes) {
+    size_t rows = shape[0], cols = shape[1];
+    std::string name = std::to_string(rows) + "x" + std::to_string(cols);
+
+    // Double precision matVec, axpy and gemm
+    size_t stride = padToLine(cols), outStride = padToLine(rows);
+    AlignedVector w(rows * stride, 0.0), x(stride, 0.0), bias(outStride, 0.0);
+    for (size_t r = 0; r < rows; ++r) {
+      for (size_t c = 0; c < cols; ++c) {
+        w[r * stride + c] = 2.0 * rng.uniform() - 1.0;
+      }
+    }
+    fill(x, cols, rng, 1.0);
+    fill(bias, rows, rng, 1.0);
+
+    AlignedVector y(outStride, 0.0), yRef(outStride, 0.0);
+    k.matVec(w.data(), stride, rows, x.data(), bias.data(), y.data());
+    ref.matVec(w.data(), stride, rows, x.data(), bias.data(), yRef.data());
+    for (size_t r = 0; r < rows; ++r) {
+      checkNear(y[r], yRef[r], 1e-12, "matVec " + name);
+    }
+
+    AlignedVector sum(stride, 0.0), sumRef(stride, 0.0);
+    fill(sum, cols, rng, 1.0);
+    sumRef = sum;
+    k.axpy(stride, 0.37, x.data(), sum.data());
+    ref.axpy(stride, 0.37, x.data(), sumRef.data());
+    for (size_t c = 0; c < stride; ++c) {
+      checkNear(sum[c], sumRef[c], 1e-15, "axpy " + name);
+    }
+
+    // gemm: a batch of rows inputs of cols values against the transposed
+    // weights (cols x rows)
+    AlignedVector a(rows * stride, 0.0), packed(cols * outStride, 0.0);
+    for (size_t r = 0; r < rows; ++r) {
+      fill(x, cols, rng, 1.0);
+      std::copy_n(x.data(), cols, &a[r * stride]);
+    }
+    for (size_t c = 0; c < cols; ++c) {
+      for (size_t r = 0; r < rows; ++r) {
+        packed[c * outStride + r] = w[r * stride + c];
+      }
+    }
+    AlignedVector out(rows * outStride, 0.0), outRef(rows * outStride, 0.0);
+    k.gemm(a.data(), stride, rows, cols, packed.data(), outStride, bias.data(),
+           out.data(), outStride);
+    ref.gemm(a.data(), stride, rows, cols, packed.data(), outStride,
+             bias.data(), outRef.data(), outStride);
+    for (size_t i = 0; i < out.size(); ++i) {
+      checkNear(out[i], outRef[i], 1e-12, "gemm " + name);
+    }
+
+    // Single precision matVec
+    size_t strideF = padToLineOf<float>(cols);
+    size_t outStrideF = padToLineOf<float>(rows);
+    AlignedFloatVector wf(rows * strideF, 0.0f), xf(strideF, 0.0f);
+    AlignedFloatVector bf(outStrideF, 0.0f);
+    for (size_t r = 0; r < rows; ++r) {
+      std::copy_n(&w[r * stride], cols, &wf[r * strideF]);
+    }
+    fill(xf, cols, rng, 1.0);
+    fill(bf, rows, rng, 1.0);
+    AlignedFloatVector yf(outStrideF, 0.0f), yfRef(outStrideF, 0.0f);
+    k.matVecF32(wf.data(), strideF, rows, xf.data(), bf.data(), yf.data());
+    ref.matVecF32(wf.data(), strideF, rows, xf.data(), bf.data(),
+                  yfRef.data());
+    for (size_t r = 0; r < rows; ++r) {
+      checkNear(yf[r], yfRef[r], 1e-5, "matVecF32 " + name);
+    }
+
+    // int8 matVec, which must be exact
+    size_t stride8 = padToLineOf<int8_t>(cols);
+    AlignedInt8Vector w8(rows * stride8, 0);
+    AlignedUint8Vector x8(stride8, 0);
+    for (size_t r = 0; r < rows; ++r) {
+      for (size_t c = 0; c < cols; ++c) {
+        w8[r * stride8 + c] = static_cast<int8_t>(rng.below(255)) - 127;
+      }
+    }
+    for (size_t c = 0; c < cols; ++c) {
+      x8[c] = static_cast<uint8_t>(rng.below(256));
+    }
+    std::vector<int32_t> y8(rows), y8Ref(rows);
+    k.matVecI8(w8.data(), stride8, rows, x8.data(), y8.data());
+    ref.matVecI8(w8.data(), stride8, rows, x8.data(), y8Ref.data());
+    check(y8 == y8Ref, "matVecI8 " + name);
+  }
+
+  // Sigmoids over any length, including saturated inputs
+  for (size_t n : {1, 3, 8, 13, 100}) {
+    std::string name = std::to_string(n);
+    AlignedVector s(padToLine(n), 0.0);
+    fill(s, n, rng, 40.0);
+    AlignedVector sRef = s;
+    k.sigmoid(n, s.data());
+    ref.sigmoid(n, sRef.data());
+    for (size_t i = 0; i < n; ++i) {
+      checkNear(s[i], sRef[i], 1e-12, "sigmoid " + name);
+    }
+
+    AlignedFloatVector sf(padToLineOf<float>(n), 0.0f);
+    fill(sf, n, rng, 40.0);
+    AlignedFloatVector sfRef = sf;
+    k.sigmoidF32(n, sf.data());
+    ref.sigmoidF32(n, sfRef.data());
+    for (size_t i = 0; i < n; ++i) {
+      checkNear(sf[i], sfRef[i], 1e-6, "sigmoidF32 " + name);
+    }
+  }
+}
+
+// Batched forward passes against the per-sample ones
+void testBatch() {
+  const size_t count = 200;
+  std::vector<double> states = randomPlayStates(count, TEST_SEED);
+  size_t outputCount = NETWORK_TOPOLOGY.back();
+
+  NeuralNetwork nn(NETWORK_TOPOLOGY, TEST_SEED);
+  std::vector<double> outputs(count * outputCount);
+  std::vector<int> actions(count);
+  nn.feedForwardBatch(states.data(), count, outputs.data());
+  nn.getActionBatch(states.data(), count, actions.data());
+  for (size_t i = 0; i < count; ++i) {
+    const double *state = &states[i * SnakeGame::STATE_SIZE];
+    const double *expected = nn.feedForward(state);
+    for (size_t o = 0; o < outputCount; ++o) {
+      checkNear(outputs[i * outputCount + o], expected[o], 1e-12,
+                "feedForwardBatch row " + std::to_string(i));
+    }
+    check(actions[i] == nn.getAction(state),
+          "getActionBatch row " + std::to_string(i));
+  }
+}
+
+// A minibatch update of one transition is the same step as an online update
+void testBatchUpdate() {
+  const size_t count = 200;
+  std::vector<double> states = randomPlayStates(count, TEST_SEED);
+  NeuralNetwork online(NETWORK_TOPOLOGY, TEST_SEED);
+  NeuralNetwork batched(NETWORK_TOPOLOGY, TEST_SEED);
+  Rng rng(TEST_SEED, Stream::EXPLORATION);
+  for (size_t i = 0; i + 1 < count; ++i) {
+    const double *state = &states[i * SnakeGame::STATE_SIZE];
+    const double *next = state + SnakeGame::STATE_SIZE;
+    int action = static_cast<int>(rng.below(4));
+    double reward = 2.0 * rng.uniform() - 1.0;
+    uint8_t done = rng.below(10) == 0;
+
+    online.updateQValues(state, action, reward, next, done, DISCOUNT_FACTOR,
+                         LEARNING_RATE);
+    batched.updateQValuesBatch(state, &action, &reward, next, &done, 1,
+                               DISCOUNT_FACTOR, LEARNING_RATE);
+    checkNear(batched.getError(), online.getError(), 1e-9,
+              "TD error of update " + std::to_string(i));
+  }
+  const AlignedVector &w = online.getWeightBuffer();
+  const AlignedVector &wBatched = batched.getWeightBuffer();
+  for (size_t i = 0; i < w.size(); ++i) {
+    checkNear(wBatched[i], w[i], 1e-9, "weight " + std::to_string(i));
+  }
+  const AlignedVector &b = online.getBiasBuffer();
+  const AlignedVector &bBatched = batched.getBiasBuffer();
+  for (size_t i = 0; i < b.size(); ++i) {
+    checkNear(bBatched[i], b[i], 1e-9, "bias " + std::to_string(i));
+  }
+}
+
+// Float and int8 engines stay close to the double precision network
+void testReducedPrecision() {
+  const size_t count = 2000;
+  std::vector<double> states = randomPlayStates(count, TEST_SEED);
+  NeuralNetwork nn(NETWORK_TOPOLOGY, TEST_SEED);
+
+  FloatNetwork single(nn);
+  InferenceAccuracy accuracy =
+      checkAccuracy(nn, single, states.data(), count);
+  check(accuracy.maxOutputError < 1e-5, "FloatNetwork max error");
+  check(accuracy.actionAgreement > 0.999, "FloatNetwork agreement");
+
+  std::vector<double> calibration = randomPlayStates(count, TEST_SEED + 1);
+  QuantizedNetwork quantized(nn, calibration.data(), count);
+  accuracy = checkAccuracy(nn, quantized, states.data(), count);
+  check(accuracy.meanOutputError < 1e-2, "QuantizedNetwork mean error");
+  check(accuracy.actionAgreement > 0.9, "QuantizedNetwork agreement");
+}
+
+// The compile-time specialized network computes what NeuralNetwork does
+void testFixedNetwork() {
+  const size_t count = 2000;
+  std::vector<double> states = randomPlayStates(count, TEST_SEED);
+  NeuralNetwork nn(NETWORK_TOPOLOGY, TEST_SEED);
+
+  SnakeNetwork fixed(nn);
+  for (size_t i = 0; i < count; ++i) {
+    const double *state = &states[i * SnakeGame::STATE_SIZE];
+    std::array<double, SnakeNetwork::OUTPUTS> actual = fixed.feedForward(state);
+    const double *expected = nn.feedForward(state);
+    for (int o = 0; o < SnakeNetwork::OUTPUTS; ++o) {
+      checkNear(actual[o], expected[o], 1e-12,
+                "FixedNetwork row " + std::to_string(i));
+    }
+    check(fixed.getAction(state) == nn.getAction(state),
+          "FixedNetwork action " + std::to_string(i));
+  }
+}
+
+// Weight files round trip exactly and reject damaged copies
+void testWeightsFile() {
+  const std::string filename = "test_weights.bin";
+  const std::string damaged = "test_weights_damaged.bin";
+  NeuralNetwork nn(NETWORK_TOPOLOGY, TEST_SEED);
+  const char extra[] = "training state";
+  check(WeightsFile::save(filename, nn.getTopology(),
+                          nn.getWeightBuffer().data(),
+                          nn.getWeightBuffer().size(),
+                          nn.getBiasBuffer().data(), nn.getBiasBuffer().size(),
+                          extra, sizeof(extra)),
+        "save");
+
+  {
+    WeightsFile file;
+    check(file.open(filename), "open");
+    if (file.isOpen()) {
+      check(file.getTopology() == nn.getTopology(), "topology");
+      check(file.weightCount() == nn.getWeightBuffer().size() &&
+                std::equal(file.weightData(),
+                           file.weightData() + file.weightCount(),
+                           nn.getWeightBuffer().begin()),
+            "weights");
+      check(file.biasCount() == nn.getBiasBuffer().size() &&
+                std::equal(file.biasData(), file.biasData() + file.biasCount(),
+                           nn.getBiasBuffer().begin()),
+            "biases");
+      check(file.extraSize() == sizeof(extra) &&
+                std::memcmp(file.extraData(), extra, sizeof(extra)) == 0,
+            "extra section");
+
+      NeuralNetwork loaded(NETWORK_TOPOLOGY, TEST_SEED + 1);
+      check(loaded.loadWeights(file) &&
+                loaded.getWeightBuffer() == nn.getWeightBuffer() &&
+                loaded.getBiasBuffer() == nn.getBiasBuffer(),
+            "loadWeights");
+    }
+  }
+
+  // One flipped bit in the header, the topology, a weight or the extra
+  // section, and a truncated file, must all be refused
+  std::vector<char> bytes = readFile(filename);
+  const size_t flips[] = {8, sizeof(WeightsHeader) + 1, bytes.size() / 2,
+                          bytes.size() - 1};
+  for (size_t offset : flips) {
+    std::vector<char> copy = bytes;
+    copy[offset] ^= 0x10;
+    writeFile(damaged, copy);
+    WeightsFile file;
+    check(!file.open(damaged), "bit flip at " + std::to_string(offset));
+  }
+  writeFile(damaged, std::vector<char>(bytes.begin(), bytes.end() - 8));
+  WeightsFile truncated;
+  check(!truncated.open(damaged), "truncated file");
+
+  std::remove(filename.c_str());
+  std::remove(damaged.c_str());
+}
+
+// MappedNetwork reads the saved weights in place, so it gives exactly the
+// network's results
+void testMappedNetwork() {
+  const size_t count = 2000;
+  const std::string filename = "test_mapped.bin";
+  std::vector<double> states = randomPlayStates(count, TEST_SEED);
+  NeuralNetwork nn(NETWORK_TOPOLOGY, TEST_SEED);
+  nn.saveWeights(filename);
+
+  auto file = std::make_shared<WeightsFile>();
+  check(file->open(filename), "open mapped weights");
+  if (file->isOpen()) {
+    MappedNetwork mapped(file);
+    InferenceAccuracy accuracy =
+        checkAccuracy(nn, mapped, states.data(), count);
+    check(accuracy.maxOutputError == 0.0, "MappedNetwork max error");
+    check(accuracy.actionAgreement == 1.0, "MappedNetwork agreement");
+  }
+  std::remove(filename.c_str());
+}
+
+// A record torn by a crash is hidden from readers and cut off by the next
+// writer, which continues the log from there
+void testTransitionLog() {
+  const std::string filename = "test_transitions.log";
+  std::remove(filename.c_str());
+
+  auto transition = [](size_t i) {
+    Transition t;
+    for (size_t s = 0; s < GAME_STATE_SIZE; ++s) {
+      t.state[s] = static_cast<double>((i + s) % 5);
+      t.nextState[s] = static_cast<double>((i + s + 1) % 5);
+    }
+    t.action = static_cast<int>(i % 4);
+    t.reward = 0.25 * static_cast<double>(i);
+    t.done = i % 7 == 0;
+    return t;
+  };
+  auto matches = [&](const TransitionLog &log, size_t i) {
+    Transition expected = transition(i), actual;
+    log.get(i, actual);
+    return actual.action == expected.action &&
+           actual.reward == expected.reward && actual.done == expected.done &&
+           std::equal(actual.state, actual.state + GAME_STATE_SIZE,
+                      expected.state) &&
+           std::equal(actual.nextState, actual.nextState + GAME_STATE_SIZE,
+                      expected.nextState);
+  };
+
+  // More than one writer buffer, so the I/O thread writes several
+  const size_t first = TransitionLogWriter::BUFFER_RECORDS + 100;
+  {
+    TransitionLogWriter writer(filename);
+    check(writer.isOpen(), "create log");
+    for (size_t i = 0; i < first; ++i) {
+      writer.append(transition(i));
+    }
+  }
+
+  // Half a record, as if the process died mid-write
+  {
+    std::ofstream file(filename, std::ios::binary | std::ios::app);
+    std::vector<char> partial(sizeof(TransitionRecord) / 2, 'x');
+    file.write(partial.data(), partial.size());
+  }
+  {
+    TransitionLog log;
+    check(log.open(filename), "open torn log");
+    check(log.size() == first, "torn record ignored by reader");
+    check(log.size() == first && matches(log, 0) && matches(log, first - 1),
+          "records before the torn one");
+  }
+
+  const size_t second = 50;
+  {
+    TransitionLogWriter writer(filename);
+    check(writer.isOpen() && writer.size() == first, "reopen torn log");
+    for (size_t i = first; i < first + second; ++i) {
+      writer.append(transition(i));
+    }
+  }
+  TransitionLog log;
+  check(log.open(filename, false), "open continued log");
+  check(log.size() == first + second, "continued record count");
+  check(readFile(filename).size() == sizeof(TransitionLogHeader) +
+                                         (first + second) *
+                                             sizeof(TransitionRecord),
+        "torn record cut off");
+  bool all = log.size() == first + second;
+  for (size_t i = 0; all && i < log.size(); ++i) {
+    all = matches(log, i);
+  }
+  check(all, "every record");
+  log.close();
+  std::remove(filename.c_str());
+}
+
+// VecSnakeEnv game i plays like SnakeGame with episode i's food stream, on
+// boards large and small enough to be won
+void testVecEnv() {
+  const int boards[][2] = {{20, 40}, {4, 4}, {5, 4}};
+  const size_t games = 3;
+  for (const auto &board : boards) {
+    std::string name =
+        std::to_string(board[0]) + "x" + std::to_string(board[1]);
+    VecSnakeEnv env(games, board[0], board[1], TEST_SEED);
+    std::vector<std::unique_ptr<SnakeGame>> reference;
+    for (size_t i = 0; i < games; ++i) {
+      reference.push_back(std::make_unique<SnakeGame>(
+          board[0], board[1], Rng::streamKey(TEST_SEED, Stream::GAME, i)));
+    }
+
+    Rng rng(TEST_SEED, Stream::EXPLORATION);
+    std::vector<int> actions(games);
+    std::vector<double> nextStates(games * VecSnakeEnv::STATE_SIZE);
+    std::vector<double> rewards(games);
+    std::vector<uint8_t> dones(games);
+    double state[SnakeGame::STATE_SIZE];
+    size_t mismatches = 0, wins = 0;
+    for (int step = 0; step < 20000; ++step) {
+      for (int &action : actions) {
+        action = static_cast<int>(rng.below(4));
+      }
+      env.step(actions.data(), nextStates.data(), rewards.data(),
+               dones.data());
+
+      for (size_t i = 0; i < games; ++i) {
+        SnakeGame &game = *reference[i];
+        game.step(static_cast<SnakeGame::Direction>(actions[i]));
+        game.getGameState(state);
+        bool same = rewards[i] == game.calculateReward() &&
+                    static_cast<bool>(dones[i]) == game.isGameOver() &&
+                    std::equal(state, state + SnakeGame::STATE_SIZE,
+                               &nextStates[i * VecSnakeEnv::STATE_SIZE]);
+        mismatches += !same;
+        if (game.isGameOver()) {
+          wins += game.getDeathCause() == SnakeGame::BOARD_FULL;
+          game.reset();
+        }
+      }
+    }
+    check(mismatches == 0, "VecSnakeEnv " + name + " matches SnakeGame");
+    if (board[0] * board[1] <= 20) {
+      check(wins > 0, "VecSnakeEnv " + name + " reached a win");
+    }
+  }
+}
+
+struct Test {
+  const char *name;
+  void (*run)();
+};
+
+const Test TESTS[] = {
+    {"kernels", testKernels},
+    {"batch", testBatch},
+    {"batch_update", testBatchUpdate},
+    {"reduced_precision", testReducedPrecision},
+    {"fixed_network", testFixedNetwork},
+    {"weights_file", testWeightsFile},
+    {"mapped_network", testMappedNetwork},
+    {"transition_log", testTransitionLog},
+    {"vec_env", testVecEnv},
+};
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  std::string only = argc > 1 ? argv[1] : "";
+  bool found = false;
+  for (const Test &test : TESTS) {
+    if (!only.empty() && only != test.name) {
+      continue;
+    }
+    found = true;
+    int before = failures;
+    bool wasSkipped = skipped;
+    std::printf("%s\n", test.name);
+    test.run();
+    if (failures != before) {
+      std::printf("  FAILED\n");
+    } else if (skipped == wasSkipped) {
+      std::printf("  ok\n");
+    }
+  }
+
+  if (!found) {
+    std::fprintf(stderr, "Unknown test: %s\n", only.c_str());
+    return 1;
+  }
+  return failures > 0 ? 1 : skipped ? SKIPPED : 0;
+}
@@ -0,0 +1,113 @@
+#include "thread_pool.h"
+
+namespace {
+thread_local int workerIndex = -1;
+} // namespace
+
+WorkStealingPool::WorkStealingPool(size_t threads) {
+  if (threads == 0) {
+    threads = 1;
+  }
+
+  for (size_t i = 0; i < threads; ++i) {
+    queues.push_back(std::make_unique<Worker>());
+  }
+  for (size_t i = 0; i < threads; ++i) {
+    workers.emplace_back(&WorkStealingPool::workerLoop, this, i);
+  }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+  {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    stopping = true;
+  }
+  taskAvailable.notify_all();
+
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+int WorkStealingPool::currentWorker() { return workerIndex; }
+
+void WorkStealingPool::submit(std::function<void()> task) {
+  size_t target = workerIndex >= 0
+                      ? static_cast<size_t>(workerIndex)
+                      : nextQueue.fetch_add(1) % queues.size();
+  {
+    std::lock_guard<std::mutex> lock(queues[target]->mutex);
+    queues[target]->tasks.push_back(std::move(task));
+  }
+  {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    queued++;
+    pending++;
+  }
+  taskAvailable.notify_one();
+}
+
+void WorkStealingPool::wait() {
+  std::unique_lock<std::mutex> lock(stateMutex);
+  allDone.wait(lock, [this] { return pending == 0; });
+}
+
+bool WorkStealingPool::popTask(size_t index, std::function<void()> &task) {
+  // Own deque first, newest task (LIFO keeps its data warm in cache)
+  {
+    Worker &own = *queues[index];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.tasks.empty()) {
+      task = std::move(own.tasks.back());
+      own.tasks.pop_back();
+      return true;
+    }
+  }
+
+  // Steal the oldest task from another worker
+  for (size_t offset = 1; offset < queues.size(); ++offset) {
+    Worker &victim = *queues[(index + offset) % queues.size()];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.tasks.empty()) {
+      task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void WorkStealingPool::workerLoop(size_t index) {
+  workerIndex = static_cast<int>(index);
+
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(stateMutex);
+      taskAvailable.wait(lock, [this] { return stopping || queued > 0; });
+      if (stopping && queued == 0) {
+        return;
+      }
+
+      // Claim one task. Tasks are pushed before they are counted, so a
+      // claimed task is always sitting in some deque.
+      queued--;
+    }
+
+    std::function<void()> task;
+    while (!popTask(index, task)) {
+      std::this_thread::yield();
+    }
+
+    task();
+
+    bool finished;
+    {
+      std::lock_guard<std::mutex> lock(stateMutex);
+      finished = --pending == 0;
+    }
+    if (finished) {
+      allDone.notify_all();
+    }
+  }
+}
@@ -0,0 +1,62 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size thread pool with per-worker task deques. A worker runs tasks
+// from the back of its own deque and, when that is empty, steals from the
+// front of the others, so long and short tasks even out across threads.
+class WorkStealingPool {
+public:
+  // Constructor and destructor
+  explicit WorkStealingPool(size_t threads);
+  ~WorkStealingPool();
+
+  WorkStealingPool(const WorkStealingPool &) = delete;
+  WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+  // Queue a task. Tasks submitted from a worker go to that worker's deque,
+  // others are spread round-robin.
+  void submit(std::function<void()> task);
+
+  // Block until every submitted task has finished
+  void wait();
+
+  // Number of worker threads
+  size_t size() const { return workers.size(); }
+
+  // Index of the calling worker thread, or -1 outside the pool
+  static int currentWorker();
+
+private:
+  struct Worker {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  std::vector<std::unique_ptr<Worker>> queues;
+  std::vector<std::thread> workers;
+
+  // Wakes idle workers and wait()
+  std::mutex stateMutex;
+  std::condition_variable taskAvailable;
+  std::condition_variable allDone;
+  size_t queued = 0;  // Tasks sitting in deques
+  size_t pending = 0; // Tasks queued or running
+  bool stopping = false;
+
+  std::atomic<size_t> nextQueue{0};
+
+  void workerLoop(size_t index);
+  bool popTask(size_t index, std::function<void()> &task);
+};
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,89 @@
+#ifndef TRAINING_H
+#define TRAINING_H
+
+#include "fixed_network.h"
+#include "rng.h"
+#include "transition.h"
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Network shape: the 8 game state values (see SnakeGame::getGameState()) in,
+// 16 hidden neurons, one Q-value per direction (UP, RIGHT, DOWN, LEFT) out
+using SnakeNetwork = FixedNetwork<GAME_STATE_SIZE, 16, 4>;
+const std::vector<int> NETWORK_TOPOLOGY = SnakeNetwork::topology();
+
+// Constants for RL
+const double LEARNING_RATE = 0.1;
+const double DISCOUNT_FACTOR = 0.90;
+const double EXPLORATION_RATE_START = 1.0;
+const double EXPLORATION_RATE_END = 0.01;
+const int EXPLORATION_DECAY_STEPS = 15000;
+const int EXPLORATION_DECAY_EPISODES = 300;
+// Typical --target interval; the target network is off unless requested
+const int TARGET_SYNC_INTERVAL = 1000;
+const std::string WEIGHTS_FILE = "snake_ai_weights.bin";
+
+// Checkpoints are written every CHECKPOINT_INTERVAL episodes as
+// CHECKPOINT_PREFIX.<episode>.bin (see checkpoint.h)
+const std::string CHECKPOINT_PREFIX = "snake_ai_checkpoint";
+const int CHECKPOINT_INTERVAL = 5;
+const int CHECKPOINTS_KEPT = 3;
+
+// Episodes between hot-path timing summaries in profiling builds
+// (profiling.h)
+const int PROFILE_REPORT_INTERVAL = 100;
+
+// Epsilon for epsilon-greedy exploration after totalSteps training steps
+inline double explorationRate(long totalSteps) {
+  return EXPLORATION_RATE_START +
+         (EXPLORATION_RATE_END - EXPLORATION_RATE_START) *
+             std::min(1.0, (double)totalSteps / EXPLORATION_DECAY_STEPS);
+}
+
+// Epsilon held for a whole episode, for trainers whose step count at the
+// start of an episode depends on thread scheduling
+inline double episodeExplorationRate(int episode) {
+  return EXPLORATION_RATE_START +
+         (EXPLORATION_RATE_END - EXPLORATION_RATE_START) *
+             std::min(1.0, (double)episode / EXPLORATION_DECAY_EPISODES);
+}
+
+// Command line options for training
+struct TrainOptions {
+  int episodes = 1000;
+  int envCount = 1;          // Games stepped together (--envs)
+  int threads = 1;           // Actor threads (--threads)
+  size_t replayCapacity = 0; // Replay buffer size, 0 trains online (--replay)
+  bool prioritized = false;  // Prioritized replay (--prioritized)
+  bool doubleDQN = false;    // Double DQN targets (--double-dqn)
+
+  // Updates between target network syncs; 0, the default, trains without a
+  // target network (--target)
+  int targetSync = 0;
+
+  // Continue from the newest checkpoint; episodes then counts the total,
+  // including those already trained (--resume). Only the weights, target
+  // network and progress are restored. Replay contents and the random streams
+  // of --envs games start afresh, and --threads actors start from the resumed
+  // weights, so only plain online training resumes into the same run as an
+  // uninterrupted one.
+  bool resume = false;
+  int keepCheckpoints = CHECKPOINTS_KEPT; // Rolling checkpoints (--checkpoints)
+
+  // Run seed for every random stream (rng.h); random unless given (--seed)
+  uint64_t seed = randomSeed();
+
+  // Append every transition trained on to this log (transition_log.h);
+  // empty records nothing (--record)
+  std::string recordFile;
+};
+
+// Train with actor threads playing episodes against copies of the network a
+// few episodes per thread behind, while the calling thread learns from their
+// transitions in episode order. A seed reproduces a run for the same
+// --threads (parallel_trainer.cpp).
+void trainAIParallel(const TrainOptions &options);
+
+#endif // TRAINING_H
@@ -0,0 +1,21 @@
+#ifndef TRANSITION_H
+#define TRANSITION_H
+
+#include <cstddef>
+
+// Number of values in a game state (see SnakeGame::getGameState()). The one
+// definition: SnakeGame, VecSnakeEnv, the network input layer and the
+// transition log all take their size from it.
+constexpr size_t GAME_STATE_SIZE = 8;
+
+// One step of experience: the state an action was taken in, the reward it
+// earned and the state it led to
+struct Transition {
+  double state[GAME_STATE_SIZE];
+  int action;
+  double reward;
+  double nextState[GAME_STATE_SIZE];
+  bool done;
+};
+
+#endif // TRANSITION_H
@@ -0,0 +1,251 @@
+#include "transition_log.h"
+#include "weights_file.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+TransitionLogHeader makeHeader() {
+  TransitionLogHeader header{};
+  std::memcpy(header.magic, TRANSITION_LOG_MAGIC, sizeof(TRANSITION_LOG_MAGIC));
+  header.version = TRANSITION_LOG_VERSION;
+  header.byteOrder = WEIGHTS_BYTE_ORDER;
+  header.stateSize = GAME_STATE_SIZE;
+  header.recordSize = sizeof(TransitionRecord);
+  header.headerChecksum =
+      crc32c(&header, offsetof(TransitionLogHeader, headerChecksum));
+  return header;
+}
+
+// Print why header is unusable and return false
+bool checkHeader(const TransitionLogHeader &header,
+                 const std::string &filename) {
+  if (std::memcmp(header.magic, TRANSITION_LOG_MAGIC,
+                  sizeof(TRANSITION_LOG_MAGIC)) != 0 ||
+      header.byteOrder != WEIGHTS_BYTE_ORDER) {
+    std::cerr << "Not a transition log: " << filename << std::endl;
+    return false;
+  }
+  if (header.version != TRANSITION_LOG_VERSION) {
+    std::cerr << "Unsupported transition log version " << header.version
+              << ": " << filename << std::endl;
+    return false;
+  }
+  if (header.headerChecksum !=
+          crc32c(&header, offsetof(TransitionLogHeader, headerChecksum)) ||
+      header.stateSize != GAME_STATE_SIZE ||
+      header.recordSize != sizeof(TransitionRecord)) {
+    std::cerr << "Corrupt transition log header: " << filename << std::endl;
+    return false;
+  }
+  return true;
+}
+
+} // namespace
+
+TransitionLogWriter::TransitionLogWriter(const std::string &filename)
+    : filename(filename) {
+  fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+  if (fd < 0) {
+    std::cerr << "Error opening file for writing: " << filename << std::endl;
+    return;
+  }
+
+  struct stat info;
+  bool ready = fstat(fd, &info) == 0;
+  size_t size = ready ? info.st_size : 0;
+  if (ready && size == 0) {
+    TransitionLogHeader header = makeHeader();
+    ready = writeAll(fd, &header, sizeof(header));
+    if (!ready) {
+      std::cerr << "Error writing transition log: " << filename << std::endl;
+    }
+  } else if (ready) {
+    // Continue an existing log, cutting off a record torn by a crash
+    TransitionLogHeader header;
+    ready = size >= sizeof(header) &&
+            pread(fd, &header, sizeof(header), 0) ==
+                static_cast<ssize_t>(sizeof(header)) &&
+            checkHeader(header, filename);
+    records = ready ? (size - sizeof(header)) / sizeof(TransitionRecord) : 0;
+    size_t end = sizeof(header) + records * sizeof(TransitionRecord);
+    if (ready && end != size && ftruncate(fd, end) != 0) {
+      std::cerr << "Error truncating transition log: " << filename
+                << std::endl;
+      ready = false;
+    }
+  }
+  if (!ready) {
+    ::close(fd);
+    fd = -1;
+    return;
+  }
+
+  filling.reserve(BUFFER_RECORDS);
+  pending.reserve(BUFFER_RECORDS);
+  writing.reserve(BUFFER_RECORDS);
+  thread = std::thread(&TransitionLogWriter::run, this);
+}
+
+TransitionLogWriter::~TransitionLogWriter() {
+  if (fd < 0) {
+    return;
+  }
+
+  flush();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_one();
+  thread.join();
+
+  if (fdatasync(fd) != 0) {
+    std::cerr << "Error syncing transition log: " << filename << std::endl;
+  }
+  ::close(fd);
+}
+
+void TransitionLogWriter::append(const Transition &t) {
+  append(t.state, t.action, t.reward, t.nextState, t.done);
+}
+
+void TransitionLogWriter::append(const double *state, int action,
+                                 double reward, const double *nextState,
+                                 bool done) {
+  if (fd < 0) {
+    return;
+  }
+
+  TransitionRecord &record = filling.emplace_back();
+  std::copy_n(state, GAME_STATE_SIZE, record.state);
+  std::copy_n(nextState, GAME_STATE_SIZE, record.nextState);
+  record.reward = reward;
+  record.action = static_cast<uint8_t>(action);
+  record.done = done;
+  records++;
+
+  if (filling.size() == BUFFER_RECORDS) {
+    handOff();
+  }
+}
+
+void TransitionLogWriter::flush() {
+  if (fd < 0) {
+    return;
+  }
+  if (!filling.empty()) {
+    handOff();
+  }
+  std::unique_lock<std::mutex> lock(mutex);
+  idle.wait(lock, [this] { return !hasPending && !busy; });
+}
+
+void TransitionLogWriter::handOff() {
+  // Wait for the I/O thread to take the previous buffer, then give it this
+  // one and continue in the buffer it finished with
+  std::unique_lock<std::mutex> lock(mutex);
+  idle.wait(lock, [this] { return !hasPending; });
+  std::swap(filling, pending);
+  hasPending = true;
+  wake.notify_one();
+}
+
+void TransitionLogWriter::run() {
+  bool failed = false;
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    wake.wait(lock, [this] { return hasPending || stopping; });
+    if (!hasPending) {
+      break;
+    }
+
+    std::swap(pending, writing);
+    hasPending = false;
+    busy = true;
+    idle.notify_all();
+    lock.unlock();
+
+    // After an error the rest is dropped rather than leaving a gap
+    if (!failed &&
+        !writeAll(fd, writing.data(),
+                  writing.size() * sizeof(TransitionRecord))) {
+      std::cerr << "Error writing transition log: " << filename << std::endl;
+      failed = true;
+    }
+    writing.clear();
+
+    lock.lock();
+    busy = false;
+    idle.notify_all();
+  }
+}
+
+TransitionLog::~TransitionLog() { close(); }
+
+bool TransitionLog::open(const std::string &filename, bool sequential) {
+  close();
+
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "Error opening file for reading: " << filename << std::endl;
+    return false;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 ||
+      static_cast<size_t>(info.st_size) < sizeof(TransitionLogHeader)) {
+    std::cerr << "Transition log is truncated: " << filename << std::endl;
+    ::close(fd);
+    return false;
+  }
+
+  size_t fileSize = info.st_size;
+  void *mapping = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (mapping == MAP_FAILED) {
+    std::cerr << "Error mapping transition log: " << filename << std::endl;
+    return false;
+  }
+  data = mapping;
+  mappedSize = fileSize;
+
+  TransitionLogHeader header;
+  std::memcpy(&header, data, sizeof(header));
+  if (!checkHeader(header, filename)) {
+    close();
+    return false;
+  }
+  madvise(data, mappedSize, sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+
+  // A torn last record is not counted
+  first = reinterpret_cast<const TransitionRecord *>(
+      static_cast<const char *>(data) + sizeof(header));
+  count = (fileSize - sizeof(header)) / sizeof(TransitionRecord);
+  return true;
+}
+
+void TransitionLog::close() {
+  if (data) {
+    munmap(data, mappedSize);
+  }
+  data = nullptr;
+  mappedSize = 0;
+  first = nullptr;
+  count = 0;
+}
+
+void TransitionLog::get(size_t i, Transition &t) const {
+  const TransitionRecord &record = first[i];
+  std::copy_n(record.state, GAME_STATE_SIZE, t.state);
+  std::copy_n(record.nextState, GAME_STATE_SIZE, t.nextState);
+  t.action = record.action;
+  t.reward = record.reward;
+  t.done = record.done;
+}
@@ -0,0 +1,132 @@
+#ifndef TRANSITION_LOG_H
+#define TRANSITION_LOG_H
+
+#include "transition.h"
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Transition log format, version 1: an append-only file of experience for
+// offline training and analysis. Native endian like weight files
+// (weights_file.h).
+//
+//   header    64 bytes (TransitionLogHeader)
+//   records   fixed-size TransitionRecords, oldest first
+//
+// The record count follows from the file size. A record torn by a crash
+// mid-write is ignored by readers and cut off by the next writer. States are
+// stored as floats, which hold the game's small integer state values
+// exactly; rewards stay double.
+constexpr char TRANSITION_LOG_MAGIC[8] = {'S', 'N', 'A', 'K', 'E', 'T', 'R', 'L'};
+constexpr uint32_t TRANSITION_LOG_VERSION = 1;
+
+struct TransitionLogHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t byteOrder;
+  uint32_t stateSize;
+  uint32_t recordSize;
+  uint32_t headerChecksum; // CRC32C of the bytes before it
+  uint8_t reserved[36];
+};
+static_assert(sizeof(TransitionLogHeader) == 64,
+              "transition log header must be 64 bytes");
+
+struct TransitionRecord {
+  float state[GAME_STATE_SIZE];
+  float nextState[GAME_STATE_SIZE];
+  double reward;
+  uint8_t action;
+  uint8_t done;
+  uint8_t padding[6];
+};
+static_assert(sizeof(TransitionRecord) == 80,
+              "transition records must be 80 bytes");
+
+// Appends transitions to a log, creating it if needed. append() only copies
+// into a buffer; full buffers are written by a background thread, so the
+// caller blocks only when the disk falls two buffers behind. Nothing is
+// dropped. Not thread safe: one thread appends.
+class TransitionLogWriter {
+public:
+  // Records per buffer (1.25 MiB)
+  static constexpr size_t BUFFER_RECORDS = 16384;
+
+  // Open filename for appending; check isOpen() afterwards
+  explicit TransitionLogWriter(const std::string &filename);
+
+  // Writes everything appended and syncs the file
+  ~TransitionLogWriter();
+
+  TransitionLogWriter(const TransitionLogWriter &) = delete;
+  TransitionLogWriter &operator=(const TransitionLogWriter &) = delete;
+
+  bool isOpen() const { return fd >= 0; }
+
+  void append(const Transition &t);
+  void append(const double *state, int action, double reward,
+              const double *nextState, bool done);
+
+  // Block until every appended record has been handed to the OS
+  void flush();
+
+  // Records in the log, including those still buffered
+  uint64_t size() const { return records; }
+
+private:
+  std::string filename;
+  int fd = -1;
+  uint64_t records = 0;
+
+  // Filled by append(), waiting for the I/O thread, and being written
+  std::vector<TransitionRecord> filling, pending, writing;
+
+  std::mutex mutex;
+  std::condition_variable wake, idle;
+  bool hasPending = false;
+  bool busy = false;
+  bool stopping = false;
+  std::thread thread;
+
+  // Queue the filling buffer for writing
+  void handOff();
+
+  // I/O thread
+  void run();
+};
+
+// Read-only, memory-mapped transition log. Pages are read in on demand and
+// evicted by the kernel as needed, so logs may be far larger than RAM.
+// Records appended after open() are not seen.
+class TransitionLog {
+public:
+  TransitionLog() = default;
+  ~TransitionLog();
+  TransitionLog(const TransitionLog &) = delete;
+  TransitionLog &operator=(const TransitionLog &) = delete;
+
+  // Map and validate filename. sequential tunes kernel read-ahead for
+  // front-to-back passes; otherwise for random access.
+  bool open(const std::string &filename, bool sequential = true);
+  void close();
+  bool isOpen() const { return data != nullptr; }
+
+  size_t size() const { return count; }
+  const TransitionRecord *records() const { return first; }
+  const TransitionRecord &operator[](size_t i) const { return first[i]; }
+
+  // Record i widened back to a Transition
+  void get(size_t i, Transition &t) const;
+
+private:
+  void *data = nullptr;
+  size_t mappedSize = 0;
+  const TransitionRecord *first = nullptr;
+  size_t count = 0;
+};
+
+#endif // TRANSITION_LOG_H
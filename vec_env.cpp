@@ -0,0 +1,206 @@
+#include "vec_env.h"
+#include "profiling.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace {
+
+// Row and column offsets for UP, RIGHT, DOWN, LEFT
+const int DY[4] = {-1, 0, 1, 0};
+const int DX[4] = {0, 1, 0, -1};
+
+} // namespace
+
+VecSnakeEnv::VecSnakeEnv(size_t count, int h, int w, uint64_t seed)
+    : count(count), height(h), width(w),
+      capacity(static_cast<size_t>(h - 2) * (w - 2)), headY(count),
+      headX(count), foodY(count), foodX(count), direction(count), score(count),
+      steps(count), finishedScore(count), finishedSteps(count),
+      prevDistanceToFood(count), rngs(count), body(count * capacity),
+      ringHead(count), length(count),
+      occupied(count * static_cast<size_t>(h) * w), freeCells(count * capacity),
+      freeIndex(count * static_cast<size_t>(h) * w), freeCount(count) {
+  // Give every game its own stream
+  for (size_t i = 0; i < count; ++i) {
+    rngs[i].seed(Rng::streamKey(seed, Stream::GAME, i));
+  }
+
+  reset();
+}
+
+void VecSnakeEnv::reset() {
+  for (size_t i = 0; i < count; ++i) {
+    resetGame(i);
+  }
+}
+
+void VecSnakeEnv::setOccupied(size_t game, uint16_t cell, bool occupied) {
+  size_t cells = static_cast<size_t>(height) * width;
+  uint16_t *list = &freeCells[game * capacity];
+  uint16_t *index = &freeIndex[game * cells];
+  this->occupied[game * cells + cell] = occupied;
+
+  if (occupied) {
+    // Swap-remove the cell from the free list
+    uint16_t last = list[--freeCount[game]];
+    list[index[cell]] = last;
+    index[last] = index[cell];
+  } else {
+    index[cell] = freeCount[game];
+    list[freeCount[game]++] = cell;
+  }
+}
+
+void VecSnakeEnv::resetGame(size_t game) {
+  // Every interior cell starts free, in the same order as SnakeGame
+  freeCount[game] = 0;
+  for (int y = 1; y < height - 1; ++y) {
+    for (int x = 1; x < width - 1; ++x) {
+      setOccupied(game, y * width + x, false);
+    }
+  }
+
+  // Snake starts as a single segment, same as SnakeGame
+  headY[game] = height / 2;
+  headX[game] = width / 4;
+  direction[game] = 1; // RIGHT
+  score[game] = 0;
+  steps[game] = 0;
+
+  ringHead[game] = 0;
+  length[game] = 1;
+  uint16_t cell = headY[game] * width + headX[game];
+  body[game * capacity] = cell;
+  setOccupied(game, cell, true);
+
+  placeFood(game);
+  prevDistanceToFood[game] = std::abs(headY[game] - foodY[game]) +
+                             std::abs(headX[game] - foodX[game]);
+}
+
+void VecSnakeEnv::placeFood(size_t game) {
+  // The board is full, so there is nowhere left to put food
+  if (length[game] >= capacity) {
+    return;
+  }
+
+  // Pick a random free cell: O(1) however full the board is
+  uint16_t cell =
+      freeCells[game * capacity + rngs[game].below(freeCount[game])];
+  foodY[game] = cell / width;
+  foodX[game] = cell % width;
+}
+
+bool VecSnakeEnv::isDanger(size_t game, int y, int x) const {
+  if (y <= 0 || y >= height - 1 || x <= 0 || x >= width - 1) {
+    return true;
+  }
+  return occupied[game * static_cast<size_t>(height) * width + y * width + x];
+}
+
+void VecSnakeEnv::writeState(size_t game, double *state) const {
+  int y = headY[game], x = headX[game];
+  int dir = direction[game];
+  int right = (dir + 1) % 4, left = (dir + 3) % 4;
+
+  // Danger straight, to the right and to the left of the current heading
+  state[0] = isDanger(game, y + DY[dir], x + DX[dir]) ? 1.0 : 0.0;
+  state[1] = isDanger(game, y + DY[right], x + DX[right]) ? 1.0 : 0.0;
+  state[2] = isDanger(game, y + DY[left], x + DX[left]) ? 1.0 : 0.0;
+
+  // Direction
+  for (int d = 0; d < 4; ++d) {
+    state[3 + d] = (dir == d) ? 1.0 : 0.0;
+  }
+
+  // Food direction
+  if (foodY[game] < y)
+    state[7] = 1.0;
+  else if (foodY[game] > y)
+    state[7] = 2.0;
+  else if (foodX[game] < x)
+    state[7] = 3.0;
+  else if (foodX[game] > x)
+    state[7] = 4.0;
+  else
+    state[7] = 0.0;
+}
+
+void VecSnakeEnv::getStates(double *states) const {
+  PROFILE_SCOPE(GAME_STATE);
+
+  for (size_t i = 0; i < count; ++i) {
+    writeState(i, states + i * STATE_SIZE);
+  }
+}
+
+void VecSnakeEnv::step(const int *actions, double *nextStates, double *rewards,
+                       uint8_t *dones) {
+  PROFILE_SCOPE(GAME_UPDATE);
+
+  for (size_t i = 0; i < count; ++i) {
+    uint16_t *ring = &body[i * capacity];
+
+    // Apply the action, ignoring 180-degree turns
+    int dir = actions[i] & 3;
+    if (dir != (direction[i] + 2) % 4) {
+      direction[i] = dir;
+    }
+
+    int y = headY[i], x = headX[i];
+    prevDistanceToFood[i] = std::abs(y - foodY[i]) + std::abs(x - foodX[i]);
+    int newY = y + DY[direction[i]], newX = x + DX[direction[i]];
+    steps[i]++;
+
+    bool crashed = isDanger(i, newY, newX);
+    bool won = false;
+    if (!crashed) {
+      // Move head
+      uint16_t cell = newY * width + newX;
+      ringHead[i] = (ringHead[i] + capacity - 1) % capacity;
+      ring[ringHead[i]] = cell;
+      setOccupied(i, cell, true);
+      length[i]++;
+      headY[i] = newY;
+      headX[i] = newX;
+
+      if (newY == foodY[i] && newX == foodX[i]) {
+        score[i]++;
+        placeFood(i);
+      } else {
+        // Remove tail
+        uint32_t tail = (ringHead[i] + length[i] - 1) % capacity;
+        setOccupied(i, ring[tail], false);
+        length[i]--;
+      }
+
+      // A snake filling the whole board has won
+      won = length[i] >= capacity;
+    }
+    bool done = crashed || won;
+
+    // Reward, as in SnakeGame::calculateReward()
+    double reward;
+    if (crashed) {
+      reward = -1.0;
+    } else if (won || (length[i] > 1 && headY[i] == foodY[i] &&
+                       headX[i] == foodX[i])) {
+      reward = 1.0;
+    } else {
+      double distance =
+          std::abs(headY[i] - foodY[i]) + std::abs(headX[i] - foodX[i]);
+      reward = distance < prevDistanceToFood[i] ? 0.15 : -0.25;
+    }
+
+    writeState(i, nextStates + i * STATE_SIZE);
+    rewards[i] = reward;
+    dones[i] = done;
+
+    if (done) {
+      finishedScore[i] = score[i];
+      finishedSteps[i] = steps[i];
+      resetGame(i);
+    }
+  }
+}
@@ -0,0 +1,83 @@
+#ifndef VEC_ENV_H
+#define VEC_ENV_H
+
+#include "rng.h"
+#include "transition.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A pool of snake games stepped in lockstep. The games follow the same rules,
+// state encoding and rewards as SnakeGame, but are stored as struct-of-arrays
+// so one step() call advances all of them without per-game objects or
+// allocation. Finished games reset automatically.
+class VecSnakeEnv {
+public:
+  // Size of one game state row (see SnakeGame::getGameState())
+  static constexpr size_t STATE_SIZE = GAME_STATE_SIZE;
+
+  // Constructor. Game i places food from the run seed's GAME stream i (see
+  // Rng::streamKey()), the stream SnakeGame uses for episode i.
+  VecSnakeEnv(size_t count, int h, int w, uint64_t seed);
+
+  // Number of games in the pool
+  size_t size() const { return count; }
+
+  // Restart every game
+  void reset();
+
+  // Advance every game by one tick. actions holds one Direction index per
+  // game. nextStates (count x STATE_SIZE), rewards and dones receive the
+  // result of the step; for finished games nextStates holds the terminal
+  // state and the game is then reset, so getStates() already shows the first
+  // state of the next episode.
+  void step(const int *actions, double *nextStates, double *rewards,
+            uint8_t *dones);
+
+  // Current state of every game, count x STATE_SIZE row-major
+  void getStates(double *states) const;
+
+  // Per-game progress of the running episode
+  int getScore(size_t game) const { return score[game]; }
+  int getSteps(size_t game) const { return steps[game]; }
+
+  // Score and length of the last finished episode of a game
+  int getFinishedScore(size_t game) const { return finishedScore[game]; }
+  int getFinishedSteps(size_t game) const { return finishedSteps[game]; }
+
+private:
+  size_t count;
+  int height, width;
+  size_t capacity; // Maximum snake length (interior cells)
+
+  // Per-game scalars
+  std::vector<int> headY, headX;
+  std::vector<int> foodY, foodX;
+  std::vector<uint8_t> direction;
+  std::vector<int> score, steps;
+  std::vector<int> finishedScore, finishedSteps;
+  std::vector<double> prevDistanceToFood;
+  std::vector<Rng> rngs; // Food placement, per game
+
+  // Snake bodies: game i owns body[i * capacity, (i + 1) * capacity) as a
+  // ring of cell indices (y * width + x), head at ringHead[i]
+  std::vector<uint16_t> body;
+  std::vector<uint32_t> ringHead, length;
+
+  // Occupancy grids: game i owns occupied[i * height * width, ...)
+  std::vector<uint8_t> occupied;
+
+  // Free interior cells, as in SnakeGame: game i owns
+  // freeCells[i * capacity, ...) holding freeCount[i] cells, and each cell's
+  // position in that list in freeIndex[i * height * width + cell]
+  std::vector<uint16_t> freeCells, freeIndex;
+  std::vector<uint32_t> freeCount;
+
+  void setOccupied(size_t game, uint16_t cell, bool occupied);
+  void resetGame(size_t game);
+  void placeFood(size_t game);
+  bool isDanger(size_t game, int y, int x) const;
+  void writeState(size_t game, double *state) const;
+};
+
+#endif // VEC_ENV_H
@@ -0,0 +1,447 @@
+#include "weights_file.h"
+#include "profiling.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__x86_64__)
+#define SNAKE_CRC_HW 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Sanity limits, so a corrupt header cannot request a huge layout
+constexpr uint32_t MAX_LAYERS = 64;
+constexpr int MAX_NEURONS = 1 << 20;
+
+// Slicing-by-8 tables: table[0] is the classic byte table, table[k] advances
+// a byte k positions further, so eight bytes are folded per step. Assumes a
+// little-endian host.
+using CrcTables = std::array<std::array<uint32_t, 256>, 8>;
+
+CrcTables makeCrcTables() {
+  CrcTables tables{};
+  for (uint32_t i = 0; i < 256; ++i) {
+    uint32_t c = i;
+    for (int bit = 0; bit < 8; ++bit) {
+      c = (c & 1) ? 0x82F63B78u ^ (c >> 1) : c >> 1;
+    }
+    tables[0][i] = c;
+  }
+  for (uint32_t i = 0; i < 256; ++i) {
+    for (size_t k = 1; k < 8; ++k) {
+      uint32_t prev = tables[k - 1][i];
+      tables[k][i] = tables[0][prev & 0xFF] ^ (prev >> 8);
+    }
+  }
+  return tables;
+}
+
+uint32_t crc32cScalar(const uint8_t *bytes, size_t size, uint32_t crc) {
+  static const CrcTables t = makeCrcTables();
+
+  for (; size >= 8; size -= 8, bytes += 8) {
+    uint32_t lo, hi;
+    std::memcpy(&lo, bytes, 4);
+    std::memcpy(&hi, bytes + 4, 4);
+    lo ^= crc;
+    crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^
+          t[4][lo >> 24] ^ t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^
+          t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+  }
+  for (; size > 0; --size, ++bytes) {
+    crc = t[0][(crc ^ *bytes) & 0xFF] ^ (crc >> 8);
+  }
+  return crc;
+}
+
+#ifdef SNAKE_CRC_HW
+// SSE4.2 CRC32 instruction, eight bytes at a time
+__attribute__((target("sse4.2"))) uint32_t
+crc32cHardware(const uint8_t *bytes, size_t size, uint32_t crc) {
+  uint64_t c = crc;
+  for (; size >= 8; size -= 8, bytes += 8) {
+    uint64_t word;
+    std::memcpy(&word, bytes, 8);
+    c = _mm_crc32_u64(c, word);
+  }
+  crc = static_cast<uint32_t>(c);
+  for (; size > 0; --size, ++bytes) {
+    crc = _mm_crc32_u8(crc, *bytes);
+  }
+  return crc;
+}
+#endif
+
+using CrcFunction = uint32_t (*)(const uint8_t *, size_t, uint32_t);
+
+CrcFunction selectCrc() {
+#ifdef SNAKE_CRC_HW
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse4.2")) {
+    return crc32cHardware;
+  }
+#endif
+  return crc32cScalar;
+}
+
+// Padded row lengths and section offsets for topology, matching
+// NeuralNetwork's buffers
+void computeLayout(const std::vector<int> &topology, std::vector<size_t> &stride,
+                   std::vector<size_t> &weightOffset,
+                   std::vector<size_t> &biasOffset, size_t &weightCount,
+                   size_t &biasCount) {
+  size_t layerCount = topology.size();
+  stride.resize(layerCount);
+  for (size_t i = 0; i < layerCount; ++i) {
+    stride[i] = padToLine(topology[i]);
+  }
+
+  weightOffset.resize(layerCount - 1);
+  biasOffset.resize(layerCount - 1);
+  weightCount = biasCount = 0;
+  for (size_t layer = 0; layer + 1 < layerCount; ++layer) {
+    weightOffset[layer] = weightCount;
+    weightCount += topology[layer + 1] * stride[layer];
+    biasOffset[layer] = biasCount;
+    biasCount += stride[layer + 1];
+  }
+}
+
+bool validTopology(const std::vector<int> &topology) {
+  if (topology.size() < 2 || topology.size() > MAX_LAYERS) {
+    return false;
+  }
+  for (int neurons : topology) {
+    if (neurons <= 0 || neurons > MAX_NEURONS) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Bytes taken by the header and the padded topology section
+size_t dataOffset(size_t layerCount) {
+  return sizeof(WeightsHeader) + padToLineOf<uint32_t>(layerCount) *
+                                     sizeof(uint32_t);
+}
+
+// fsync the directory holding path, so a rename into it survives a crash
+void syncDirectory(const std::string &path) {
+  size_t slash = path.find_last_of('/');
+  std::string dir = slash == std::string::npos ? "." : path.substr(0, slash);
+  int fd = ::open(dir.empty() ? "/" : dir.c_str(), O_RDONLY | O_DIRECTORY);
+  if (fd >= 0) {
+    fsync(fd);
+    ::close(fd);
+  }
+}
+
+uint32_t headerCrc(const WeightsHeader &header) {
+  return crc32c(&header, offsetof(WeightsHeader, headerChecksum));
+}
+
+} // namespace
+
+uint32_t crc32c(const void *data, size_t size, uint32_t crc) {
+  static const CrcFunction update = selectCrc();
+  return ~update(static_cast<const uint8_t *>(data), size, ~crc);
+}
+
+bool writeAll(int fd, const void *data, size_t size) {
+  const char *bytes = static_cast<const char *>(data);
+  while (size > 0) {
+    ssize_t written = ::write(fd, bytes, size);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    bytes += written;
+    size -= written;
+  }
+  return true;
+}
+
+WeightsFile::~WeightsFile() { close(); }
+
+void WeightsFile::close() {
+  if (data) {
+    munmap(data, size);
+  }
+  data = nullptr;
+  size = 0;
+  weights = biases = nullptr;
+  extra = nullptr;
+  weightTotal = biasTotal = extraBytes = 0;
+  topology.clear();
+}
+
+bool WeightsFile::open(const std::string &filename) {
+  close();
+
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "Error opening file for reading: " << filename << std::endl;
+    return false;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 ||
+      static_cast<size_t>(info.st_size) < sizeof(WeightsHeader)) {
+    std::cerr << "Weight file is truncated: " << filename << std::endl;
+    ::close(fd);
+    return false;
+  }
+
+  size_t fileSize = info.st_size;
+  void *mapping = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (mapping == MAP_FAILED) {
+    std::cerr << "Error mapping weight file: " << filename << std::endl;
+    return false;
+  }
+  data = mapping;
+  size = fileSize;
+
+  // Header
+  const char *bytes = static_cast<const char *>(data);
+  WeightsHeader header;
+  std::memcpy(&header, bytes, sizeof(header));
+  if (std::memcmp(header.magic, WEIGHTS_MAGIC, sizeof(WEIGHTS_MAGIC)) != 0 ||
+      header.byteOrder != WEIGHTS_BYTE_ORDER) {
+    std::cerr << "Not a weight file: " << filename << std::endl;
+    close();
+    return false;
+  }
+  if (header.version != WEIGHTS_VERSION) {
+    std::cerr << "Unsupported weight file version " << header.version << ": "
+              << filename << std::endl;
+    close();
+    return false;
+  }
+  if (header.headerChecksum != headerCrc(header) ||
+      header.alignment != CACHE_LINE || header.layerCount < 2 ||
+      header.layerCount > MAX_LAYERS ||
+      size < dataOffset(header.layerCount)) {
+    std::cerr << "Corrupt weight file header: " << filename << std::endl;
+    close();
+    return false;
+  }
+
+  // Topology and the layout it implies
+  std::vector<uint32_t> sizes(header.layerCount);
+  std::memcpy(sizes.data(), bytes + sizeof(WeightsHeader),
+              sizes.size() * sizeof(uint32_t));
+  std::vector<int> loaded(sizes.begin(), sizes.end());
+
+  size_t expectedWeights = 0, expectedBiases = 0;
+  if (validTopology(loaded)) {
+    computeLayout(loaded, stride, weightOffset, biasOffset, expectedWeights,
+                  expectedBiases);
+  }
+  size_t offset = dataOffset(header.layerCount);
+  size_t expectedSize =
+      offset + (expectedWeights + expectedBiases) * sizeof(double) +
+      header.extraSize;
+  if (!validTopology(loaded) || header.extraSize > size ||
+      header.weightCount != expectedWeights ||
+      header.biasCount != expectedBiases || header.fileSize != expectedSize) {
+    std::cerr << "Corrupt weight file header: " << filename << std::endl;
+    close();
+    return false;
+  }
+  if (size != expectedSize) {
+    std::cerr << "Weight file is truncated: " << filename << std::endl;
+    close();
+    return false;
+  }
+
+  // Payload
+  if (crc32c(bytes + sizeof(WeightsHeader), size - sizeof(WeightsHeader)) !=
+      header.checksum) {
+    std::cerr << "Weight file checksum mismatch: " << filename << std::endl;
+    close();
+    return false;
+  }
+
+  topology = loaded;
+  weights = reinterpret_cast<const double *>(bytes + offset);
+  biases = weights + expectedWeights;
+  extra = biases + expectedBiases;
+  weightTotal = expectedWeights;
+  biasTotal = expectedBiases;
+  extraBytes = header.extraSize;
+  return true;
+}
+
+bool WeightsFile::save(const std::string &filename,
+                       const std::vector<int> &topology, const double *weights,
+                       size_t weightCount, const double *biases,
+                       size_t biasCount, const void *extra,
+                       size_t extraSize) {
+  PROFILE_SCOPE(SAVE_WEIGHTS);
+
+  std::vector<size_t> stride, weightOffset, biasOffset;
+  size_t expectedWeights = 0, expectedBiases = 0;
+  if (validTopology(topology)) {
+    computeLayout(topology, stride, weightOffset, biasOffset, expectedWeights,
+                  expectedBiases);
+  }
+  if (!validTopology(topology) || weightCount != expectedWeights ||
+      biasCount != expectedBiases) {
+    std::cerr << "Weight buffers do not match the topology." << std::endl;
+    return false;
+  }
+
+  // Topology section, zero padded
+  std::vector<uint32_t> sizes(padToLineOf<uint32_t>(topology.size()), 0);
+  std::copy(topology.begin(), topology.end(), sizes.begin());
+
+  WeightsHeader header{};
+  std::memcpy(header.magic, WEIGHTS_MAGIC, sizeof(WEIGHTS_MAGIC));
+  header.version = WEIGHTS_VERSION;
+  header.byteOrder = WEIGHTS_BYTE_ORDER;
+  header.layerCount = static_cast<uint32_t>(topology.size());
+  header.alignment = CACHE_LINE;
+  header.weightCount = weightCount;
+  header.biasCount = biasCount;
+  header.extraSize = extraSize;
+  header.fileSize = dataOffset(topology.size()) +
+                    (weightCount + biasCount) * sizeof(double) + extraSize;
+
+  uint32_t crc = crc32c(sizes.data(), sizes.size() * sizeof(uint32_t));
+  crc = crc32c(weights, weightCount * sizeof(double), crc);
+  crc = crc32c(biases, biasCount * sizeof(double), crc);
+  header.checksum = crc32c(extra, extraSize, crc);
+  header.headerChecksum = headerCrc(header);
+
+  // Write a temporary file, make it durable, then atomically replace
+  std::string temp = filename + ".tmp";
+  int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    std::cerr << "Error opening file for writing: " << temp << std::endl;
+    return false;
+  }
+
+  bool written =
+      writeAll(fd, &header, sizeof(header)) &&
+      writeAll(fd, sizes.data(), sizes.size() * sizeof(uint32_t)) &&
+      writeAll(fd, weights, weightCount * sizeof(double)) &&
+      writeAll(fd, biases, biasCount * sizeof(double)) &&
+      writeAll(fd, extra, extraSize) && fsync(fd) == 0;
+  written = ::close(fd) == 0 && written;
+
+  if (!written || std::rename(temp.c_str(), filename.c_str()) != 0) {
+    std::cerr << "Error writing weight file: " << filename << std::endl;
+    std::remove(temp.c_str());
+    return false;
+  }
+
+  // Make the rename itself durable
+  syncDirectory(filename);
+  return true;
+}
+
+bool WeightsFile::isLegacy(const std::string &filename) {
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  char magic[sizeof(WEIGHTS_MAGIC)] = {};
+  ssize_t bytes = ::read(fd, magic, sizeof(magic));
+  ::close(fd);
+  return bytes >= 0 && std::memcmp(magic, WEIGHTS_MAGIC, sizeof(WEIGHTS_MAGIC)) != 0;
+}
+
+bool WeightsFile::readLegacy(const std::string &filename,
+                             std::vector<int> &topology, AlignedVector &weights,
+                             AlignedVector &biases) {
+  std::ifstream file(filename, std::ios::binary | std::ios::ate);
+  if (!file) {
+    std::cerr << "Error opening file for reading: " << filename << std::endl;
+    return false;
+  }
+  size_t fileSize = file.tellg();
+  file.seekg(0);
+
+  // Read topology
+  size_t layerCount = 0;
+  file.read(reinterpret_cast<char *>(&layerCount), sizeof(layerCount));
+  if (!file || layerCount < 2 || layerCount > MAX_LAYERS) {
+    std::cerr << "Corrupt legacy weight file: " << filename << std::endl;
+    return false;
+  }
+
+  std::vector<int> loaded(layerCount);
+  file.read(reinterpret_cast<char *>(loaded.data()), layerCount * sizeof(int));
+  if (!file || !validTopology(loaded)) {
+    std::cerr << "Corrupt legacy weight file: " << filename << std::endl;
+    return false;
+  }
+
+  // The legacy format has no checksum, but its size is fixed by the topology
+  size_t expectedSize = sizeof(size_t) + layerCount * sizeof(int);
+  for (size_t layer = 0; layer + 1 < layerCount; ++layer) {
+    expectedSize += static_cast<size_t>(loaded[layer] + 1) *
+                    loaded[layer + 1] * sizeof(double);
+  }
+  if (fileSize != expectedSize) {
+    std::cerr << "Legacy weight file is truncated or corrupt: " << filename
+              << std::endl;
+    return false;
+  }
+
+  std::vector<size_t> stride, weightOffset, biasOffset;
+  size_t weightCount, biasCount;
+  computeLayout(loaded, stride, weightOffset, biasOffset, weightCount,
+                biasCount);
+  weights.assign(weightCount, 0.0);
+  biases.assign(biasCount, 0.0);
+
+  // Read weights, one unpadded row at a time
+  for (size_t layer = 0; layer + 1 < layerCount; ++layer) {
+    double *w = &weights[weightOffset[layer]];
+    for (int neuron = 0; neuron < loaded[layer + 1]; ++neuron) {
+      file.read(reinterpret_cast<char *>(w + neuron * stride[layer]),
+                loaded[layer] * sizeof(double));
+    }
+  }
+
+  // Read biases
+  for (size_t layer = 0; layer + 1 < layerCount; ++layer) {
+    file.read(reinterpret_cast<char *>(&biases[biasOffset[layer]]),
+              loaded[layer + 1] * sizeof(double));
+  }
+
+  if (!file) {
+    std::cerr << "Error reading legacy weight file: " << filename << std::endl;
+    return false;
+  }
+
+  topology = loaded;
+  return true;
+}
+
+bool WeightsFile::convertLegacy(const std::string &from,
+                                const std::string &to) {
+  std::vector<int> topology;
+  AlignedVector weights, biases;
+  return readLegacy(from, topology, weights, biases) &&
+         save(to, topology, weights.data(), weights.size(), biases.data(),
+              biases.size());
+}
@@ -0,0 +1,119 @@
+#ifndef WEIGHTS_FILE_H
+#define WEIGHTS_FILE_H
+
+#include "aligned.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Weight file format, version 1. All fields are native endian; byteOrder
+// rejects files written on a machine of the other endianness.
+//
+//   header      64 bytes (WeightsHeader)
+//   topology    layerCount uint32 values, zero padded to a cache line
+//   weights     weightCount doubles, laid out like NeuralNetwork's weights
+//               (each row padded to a cache line, padding zero)
+//   biases      biasCount doubles, laid out like NeuralNetwork's biases
+//   extra       extraSize bytes for the writer's own use, e.g. training state
+//               in checkpoints (checkpoint.h); empty in plain weight files
+//
+// Every section starts on a cache line, so a mapped file can be used in
+// place by the SIMD kernels. checksum is the CRC32C of everything after the
+// header; headerChecksum covers the header bytes before it.
+constexpr char WEIGHTS_MAGIC[8] = {'S', 'N', 'A', 'K', 'E', 'N', 'N', '\0'};
+constexpr uint32_t WEIGHTS_VERSION = 1;
+constexpr uint32_t WEIGHTS_BYTE_ORDER = 0x01020304;
+
+struct WeightsHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t byteOrder;
+  uint32_t layerCount;
+  uint32_t alignment;
+  uint64_t weightCount;
+  uint64_t biasCount;
+  uint64_t fileSize;
+  uint32_t checksum;
+  uint32_t headerChecksum;
+  uint64_t extraSize;
+};
+static_assert(sizeof(WeightsHeader) == CACHE_LINE,
+              "weight file header must fill one cache line");
+
+// CRC32C (Castagnoli polynomial), continuing from crc. Uses the SSE4.2
+// instruction when the CPU has it.
+uint32_t crc32c(const void *data, size_t size, uint32_t crc = 0);
+
+// write() until all of data is out, retrying short writes and EINTR
+bool writeAll(int fd, const void *data, size_t size);
+
+// Read-only, memory-mapped weight file. The accessors mirror NeuralNetwork's:
+// MappedNetwork (inference.h) runs straight from the mapping, and other
+// engines copy out of it without going through a NeuralNetwork. Pointers
+// stay valid until close().
+class WeightsFile {
+public:
+  WeightsFile() = default;
+  ~WeightsFile();
+  WeightsFile(const WeightsFile &) = delete;
+  WeightsFile &operator=(const WeightsFile &) = delete;
+
+  // Map and validate filename (size, version and checksums)
+  bool open(const std::string &filename);
+  void close();
+  bool isOpen() const { return data != nullptr; }
+
+  const std::vector<int> &getTopology() const { return topology; }
+  size_t getStride(size_t layer) const { return stride[layer]; }
+  const double *getWeights(size_t layer) const {
+    return weights + weightOffset[layer];
+  }
+  const double *getBiases(size_t layer) const {
+    return biases + biasOffset[layer];
+  }
+
+  // Whole weight, bias and extra sections
+  const double *weightData() const { return weights; }
+  size_t weightCount() const { return weightTotal; }
+  const double *biasData() const { return biases; }
+  size_t biasCount() const { return biasTotal; }
+  const void *extraData() const { return extra; }
+  size_t extraSize() const { return extraBytes; }
+
+  // Write a weight file from buffers laid out like NeuralNetwork's. The file
+  // is written under a temporary name, synced and renamed over filename, so
+  // a crash leaves either the old file or the new one, never a mix.
+  static bool save(const std::string &filename,
+                   const std::vector<int> &topology, const double *weights,
+                   size_t weightCount, const double *biases, size_t biasCount,
+                   const void *extra = nullptr, size_t extraSize = 0);
+
+  // True if filename exists but is not in this format, i.e. a file written
+  // before the format was versioned
+  static bool isLegacy(const std::string &filename);
+
+  // Read a legacy file (size_t layer count, int topology, unpadded weight
+  // rows, biases) into the padded layout. The file size must match its
+  // topology exactly, so truncated files are rejected.
+  static bool readLegacy(const std::string &filename,
+                         std::vector<int> &topology, AlignedVector &weights,
+                         AlignedVector &biases);
+
+  // Rewrite a legacy file in the current format
+  static bool convertLegacy(const std::string &from, const std::string &to);
+
+private:
+  void *data = nullptr;
+  size_t size = 0;
+
+  std::vector<int> topology;
+  std::vector<size_t> stride;
+  std::vector<size_t> weightOffset, biasOffset;
+  const double *weights = nullptr;
+  const double *biases = nullptr;
+  const void *extra = nullptr;
+  size_t weightTotal = 0, biasTotal = 0, extraBytes = 0;
+};
+
+#endif // WEIGHTS_FILE_H